@@ -94,6 +94,81 @@ CREATE OPERATOR CLASS sexp_ops
     FUNCTION 1 sexp_hash(sexp),
     FUNCTION 2 sexp_hash_extended(sexp, bigint);
 
+-- Ordering operators (canonical total order: type rank, then value)
+CREATE FUNCTION sexp_cmp(sexp, sexp)
+    RETURNS integer
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_lt(sexp, sexp)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_le(sexp, sexp)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_gt(sexp, sexp)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_ge(sexp, sexp)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR < (
+    LEFTARG = sexp,
+    RIGHTARG = sexp,
+    FUNCTION = sexp_lt,
+    COMMUTATOR = >,
+    NEGATOR = >=,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR <= (
+    LEFTARG = sexp,
+    RIGHTARG = sexp,
+    FUNCTION = sexp_le,
+    COMMUTATOR = >=,
+    NEGATOR = >,
+    RESTRICT = scalarlesel,
+    JOIN = scalarlejoinsel
+);
+
+CREATE OPERATOR > (
+    LEFTARG = sexp,
+    RIGHTARG = sexp,
+    FUNCTION = sexp_gt,
+    COMMUTATOR = <,
+    NEGATOR = <=,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR >= (
+    LEFTARG = sexp,
+    RIGHTARG = sexp,
+    FUNCTION = sexp_ge,
+    COMMUTATOR = <=,
+    NEGATOR = <,
+    RESTRICT = scalargesel,
+    JOIN = scalargejoinsel
+);
+
+CREATE OPERATOR CLASS sexp_btree_ops
+    DEFAULT FOR TYPE sexp USING btree AS
+    OPERATOR 1 < (sexp, sexp),
+    OPERATOR 2 <= (sexp, sexp),
+    OPERATOR 3 = (sexp, sexp),
+    OPERATOR 4 >= (sexp, sexp),
+    OPERATOR 5 > (sexp, sexp),
+    FUNCTION 1 sexp_cmp(sexp, sexp);
+
 -- List operations
 
 -- car - get first element of a list
@@ -126,6 +201,172 @@ CREATE FUNCTION head(sexp)
     AS 'MODULE_PATHNAME', 'sexp_head_func'
     LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
 
+-- append - add an element to the end of a list
+-- Returns an expanded in-memory value that PL/pgSQL reuses across loop
+-- iterations, so building a list by repeated appends is linear, not
+-- quadratic. The value flattens back to the normal binary form on storage.
+CREATE FUNCTION sexp_append(sexp, sexp)
+    RETURNS sexp
+    AS 'MODULE_PATHNAME', 'sexp_append_func'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- Constructors that emit the binary format directly from typed values,
+-- bypassing the text parser (like jsonb_build_array for jsonb)
+
+-- build_list - list from any mix of supported argument types; sexp
+-- arguments are spliced in as elements, NULL becomes nil
+CREATE FUNCTION sexp_build_list(VARIADIC "any")
+    RETURNS sexp
+    AS 'MODULE_PATHNAME', 'sexp_build_list'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+-- symbol - single symbol from text (must be a valid symbol token)
+CREATE FUNCTION sexp_symbol(text)
+    RETURNS sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- string - single string from text
+CREATE FUNCTION sexp_string(text)
+    RETURNS sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- int - single integer
+CREATE FUNCTION sexp_int(bigint)
+    RETURNS sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- float - single float
+CREATE FUNCTION sexp_float(double precision)
+    RETURNS sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- sexp_agg - aggregate rows into a list (like jsonb_agg)
+-- Appends each input's binary encoding into a growing transition buffer
+-- with an incrementally merged symbol table; combine/serial/deserial
+-- support lets it run under parallel query. NULL inputs become nil.
+CREATE FUNCTION sexp_agg_transfn(internal, sexp)
+    RETURNS internal
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION sexp_agg_finalfn(internal)
+    RETURNS sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION sexp_agg_combinefn(internal, internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION sexp_agg_serialfn(internal)
+    RETURNS bytea
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_agg_deserialfn(bytea, internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE sexp_agg(sexp) (
+    SFUNC = sexp_agg_transfn,
+    STYPE = internal,
+    FINALFUNC = sexp_agg_finalfn,
+    COMBINEFUNC = sexp_agg_combinefn,
+    SERIALFUNC = sexp_agg_serialfn,
+    DESERIALFUNC = sexp_agg_deserialfn,
+    PARALLEL = SAFE
+);
+
+-- jsonb bridge - direct binary-to-binary conversion, no intermediate text.
+-- Lists map to arrays; symbols and strings both become JSON strings;
+-- objects become lists of (key value) pairs; null becomes nil.
+CREATE FUNCTION sexp_to_jsonb(sexp)
+    RETURNS jsonb
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION jsonb_to_sexp(jsonb)
+    RETURNS sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- elements - unnest a list, one row per element (like jsonb_array_elements)
+CREATE FUNCTION sexp_elements(sexp)
+    RETURNS SETOF sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+    ROWS 10;
+
+-- elements_text - unnest a list as text, one row per element
+CREATE FUNCTION sexp_elements_text(sexp)
+    RETURNS SETOF text
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+    ROWS 10;
+
+-- extract_path - descend into nested structure by key symbols / indexes
+CREATE FUNCTION sexp_extract_path(sexp, text[])
+    RETURNS sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR #> (
+    LEFTARG = sexp,
+    RIGHTARG = text[],
+    FUNCTION = sexp_extract_path
+);
+
+-- Typed atom accessors - decode atoms straight to native types without the
+-- sexp-to-text round-trip. Non-matching types and missed paths yield NULL.
+CREATE FUNCTION sexp_as_int(sexp)
+    RETURNS bigint
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_as_float(sexp)
+    RETURNS double precision
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_as_text(sexp)
+    RETURNS text
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_as_int(sexp, text[])
+    RETURNS bigint
+    AS 'MODULE_PATHNAME', 'sexp_as_int_path'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_as_float(sexp, text[])
+    RETURNS double precision
+    AS 'MODULE_PATHNAME', 'sexp_as_float_path'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_as_text(sexp, text[])
+    RETURNS text
+    AS 'MODULE_PATHNAME', 'sexp_as_text_path'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- find_all - stream every subexpression matching a pattern
+CREATE FUNCTION sexp_find_all(sexp, sexp)
+    RETURNS SETOF sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+    ROWS 10;
+
+CREATE FUNCTION sexp_find_all(sexp, sexp, integer)
+    RETURNS SETOF sexp
+    AS 'MODULE_PATHNAME', 'sexp_find_all'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE
+    ROWS 10;
+
 -- Type inspection functions
 
 -- typeof - get type name
@@ -181,13 +422,33 @@ CREATE FUNCTION sexp_contains(sexp, sexp)
     AS 'MODULE_PATHNAME', 'sexp_contains_func'
     LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
 
+-- Selectivity estimators
+-- Grade the query operand by the number of GIN keys it produces (the
+-- same key definition the index uses), so specific queries cost out to
+-- index scans and broad ones to sequential scans. contsel's flat 0.001
+-- treated both the same.
+CREATE FUNCTION sexp_contains_sel(internal, oid, internal, integer)
+    RETURNS float8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_contains_key_sel(internal, oid, internal, integer)
+    RETURNS float8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_match_sel(internal, oid, internal, integer)
+    RETURNS float8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
 -- @> operator for structural containment
 CREATE OPERATOR @> (
     LEFTARG = sexp,
     RIGHTARG = sexp,
     FUNCTION = sexp_contains,
     COMMUTATOR = <@,
-    RESTRICT = contsel,
+    RESTRICT = sexp_contains_sel,
     JOIN = contjoinsel
 );
 
@@ -219,7 +480,7 @@ CREATE OPERATOR @>> (
     RIGHTARG = sexp,
     FUNCTION = sexp_contains_key,
     COMMUTATOR = <<@,
-    RESTRICT = contsel,
+    RESTRICT = sexp_contains_key_sel,
     JOIN = contjoinsel
 );
 
@@ -258,7 +519,7 @@ CREATE OPERATOR @~ (
     LEFTARG = sexp,
     RIGHTARG = sexp,
     FUNCTION = sexp_match,
-    RESTRICT = contsel,
+    RESTRICT = sexp_match_sel,
     JOIN = contjoinsel
 );
 
@@ -268,6 +529,24 @@ CREATE FUNCTION sexp_find(sexp, sexp)
     AS 'MODULE_PATHNAME', 'sexp_find_func'
     LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
 
+-- Multi-pattern classification. The pattern array is compiled once per
+-- scan into a set dispatched on each pattern's literal head symbol, so
+-- classifying a row costs one head lookup instead of one traversal per
+-- pattern. NULL patterns are rejected (sexp_match_which reports 1-based
+-- positions into the array).
+
+-- sexp_match_any - Does any pattern in the array match?
+CREATE FUNCTION sexp_match_any(sexp, sexp[])
+    RETURNS boolean
+    AS 'MODULE_PATHNAME', 'sexp_match_any_func'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+-- sexp_match_which - 1-based indices of the patterns that match
+CREATE FUNCTION sexp_match_which(sexp, sexp[])
+    RETURNS integer[]
+    AS 'MODULE_PATHNAME', 'sexp_match_which_func'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
 -- Convenience functions
 
 -- Create nil
@@ -281,6 +560,7 @@ CREATE FUNCTION sexp_nil()
 --   CREATE INDEX idx ON table USING gin (column sexp_gin_ops);
 --   SELECT * FROM table WHERE column @> 'atom';           -- structural
 --   SELECT * FROM table WHERE column @>> '(user (name "x"))';  -- key-based
+--   SELECT * FROM table WHERE column @~ '(user _ (age ?a))';   -- pattern
 
 -- Extract keys from stored value (for index building)
 CREATE FUNCTION sexp_gin_extract_value(sexp, internal)
@@ -309,10 +589,12 @@ CREATE FUNCTION sexp_gin_triconsistent(internal, int2, sexp, int4, internal, int
 -- GIN operator class for sexp containment
 -- Strategy 7 = @> (structural containment), matching jsonb convention
 -- Strategy 9 = @>> (key-based containment), additional operator
+-- Strategy 10 = @~ (pattern match), pre-filters on the pattern's literal atoms
 CREATE OPERATOR CLASS sexp_gin_ops
     DEFAULT FOR TYPE sexp USING gin AS
     OPERATOR 7 @> (sexp, sexp),
     OPERATOR 9 @>> (sexp, sexp),
+    OPERATOR 10 @~ (sexp, sexp),
     FUNCTION 1 btint4cmp(int4, int4),
     FUNCTION 2 sexp_gin_extract_value(sexp, internal),
     FUNCTION 3 sexp_gin_extract_query(sexp, internal, int2, internal, internal, internal, internal),
@@ -320,6 +602,123 @@ CREATE OPERATOR CLASS sexp_gin_ops
     FUNCTION 6 sexp_gin_triconsistent(internal, int2, sexp, int4, internal, internal, internal),
     STORAGE int4;
 
+-- Path-anchored GIN support (sexp_path_ops)
+-- Analogous to jsonb_path_ops: instead of position-blind atom keys, each
+-- leaf is indexed as hash(chain of enclosing head symbols, leaf value),
+-- with suffix chains up to 3 symbols deep so containment at any depth
+-- still finds its keys. Head- and path-anchored @> queries probe precise
+-- (path, value) keys and recheck only real candidates, at the cost of a
+-- larger index. Supports @> only and is not the default opclass:
+--   CREATE INDEX idx ON table USING gin (column sexp_path_ops);
+--   SELECT * FROM table WHERE column @> '(config (network (port 8080)))';
+
+CREATE FUNCTION sexp_gin_path_extract_value(sexp, internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_gin_path_extract_query(sexp, internal, int2, internal, internal, internal, internal)
+    RETURNS internal
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_gin_path_consistent(internal, int2, sexp, int4, internal, internal, internal, internal)
+    RETURNS boolean
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION sexp_gin_path_triconsistent(internal, int2, sexp, int4, internal, internal, internal)
+    RETURNS "char"
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR CLASS sexp_path_ops
+    FOR TYPE sexp USING gin AS
+    OPERATOR 7 @> (sexp, sexp),
+    FUNCTION 1 btint4cmp(int4, int4),
+    FUNCTION 2 sexp_gin_path_extract_value(sexp, internal),
+    FUNCTION 3 sexp_gin_path_extract_query(sexp, internal, int2, internal, internal, internal, internal),
+    FUNCTION 4 sexp_gin_path_consistent(internal, int2, sexp, int4, internal, internal, internal, internal),
+    FUNCTION 6 sexp_gin_path_triconsistent(internal, int2, sexp, int4, internal, internal, internal),
+    STORAGE int4;
+
+COMMENT ON OPERATOR CLASS sexp_path_ops USING gin IS 'Path-anchored GIN operator class for head/path-anchored sexp containment';
+
+-- Shared symbol dictionary
+-- Schema-heavy workloads repeat the same symbols in every value's inline
+-- symbol table. Symbols registered here can be stored as small IDs instead:
+-- with SET pg_sexp.use_symbol_dictionary = on, newly parsed values whose
+-- symbols are all present in this table reference it by ID (values with any
+-- unregistered symbol keep their inline table, so the dictionary never needs
+-- to be complete). The table contents are part of the data - values on disk
+-- reference its IDs - hence pg_extension_config_dump.
+CREATE TABLE pg_sexp_dictionary (
+    id serial PRIMARY KEY,
+    symbol text NOT NULL UNIQUE
+);
+
+SELECT pg_catalog.pg_extension_config_dump('pg_sexp_dictionary', '');
+SELECT pg_catalog.pg_extension_config_dump('pg_sexp_dictionary_id_seq', '');
+
+-- Register a symbol, returning its ID (existing ID if already present)
+CREATE FUNCTION pg_sexp_dict_add(text)
+    RETURNS int4
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C VOLATILE STRICT PARALLEL UNSAFE;
+
+-- Dictionary-trained zstd compression
+-- Cross-row redundancy (the same schema symbols and structure in every
+-- value) is invisible to per-datum TOAST compression. A zstd dictionary
+-- trained over a sample of a column captures it, so even small values
+-- compress well. Stored dictionaries are part of the data - compressed
+-- blobs reference them by ID - hence pg_extension_config_dump. Requires
+-- pg_sexp built with libzstd; without it these functions raise an error.
+CREATE TABLE pg_sexp_zstd_dictionaries (
+    id serial PRIMARY KEY,
+    source text NOT NULL,
+    created timestamptz NOT NULL DEFAULT now(),
+    nsamples integer NOT NULL,
+    sample_bytes bigint NOT NULL,
+    dict bytea NOT NULL
+);
+
+SELECT pg_catalog.pg_extension_config_dump('pg_sexp_zstd_dictionaries', '');
+SELECT pg_catalog.pg_extension_config_dump('pg_sexp_zstd_dictionaries_id_seq', '');
+
+-- Train a dictionary over a sample of the given sexp column, store it,
+-- and return its ID for use with sexp_compress
+CREATE FUNCTION sexp_compress_dictionary(regclass, text)
+    RETURNS int4
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C VOLATILE STRICT PARALLEL UNSAFE;
+
+-- Compress a value against a stored dictionary (ID 0 = no dictionary)
+CREATE FUNCTION sexp_compress(sexp, int4)
+    RETURNS bytea
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STABLE STRICT PARALLEL RESTRICTED;
+
+-- Restore a value compressed by sexp_compress; the dictionary ID is
+-- embedded in the blob and the decoded binary is validated like recv's
+CREATE FUNCTION sexp_decompress(bytea)
+    RETURNS sexp
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STABLE STRICT PARALLEL RESTRICTED;
+
+-- Runtime statistics
+-- Per-backend counters from the hot paths (Bloom filter hit rates, GIN key
+-- extraction and recheck rates, parse/output throughput). Cheap enough to
+-- stay enabled in production; values cover the calling backend only.
+CREATE FUNCTION pg_sexp_stats(OUT name text, OUT value bigint)
+    RETURNS SETOF record
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C VOLATILE PARALLEL RESTRICTED;
+
+CREATE FUNCTION pg_sexp_stats_reset()
+    RETURNS void
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C VOLATILE PARALLEL RESTRICTED;
+
 COMMENT ON TYPE sexp IS 'S-expression data type (similar to jsonb but for Lisp-like s-expressions)';
 COMMENT ON FUNCTION car(sexp) IS 'Get first element of an s-expression list';
 COMMENT ON FUNCTION cdr(sexp) IS 'Get rest of an s-expression list (all but first element)';
@@ -5,6 +5,10 @@
  */
 
 #include "pg_sexp.h"
+#include "sexp_stats.h"
+#include "funcapi.h"
+#include "catalog/pg_type.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "libpq/pqformat.h"
 #include "common/hashfn.h"
@@ -20,6 +24,11 @@ PG_FUNCTION_INFO_V1(sexp_recv);
 /* Operators */
 PG_FUNCTION_INFO_V1(sexp_eq);
 PG_FUNCTION_INFO_V1(sexp_ne);
+PG_FUNCTION_INFO_V1(sexp_lt);
+PG_FUNCTION_INFO_V1(sexp_le);
+PG_FUNCTION_INFO_V1(sexp_gt);
+PG_FUNCTION_INFO_V1(sexp_ge);
+PG_FUNCTION_INFO_V1(sexp_cmp);
 
 /* List operations */
 PG_FUNCTION_INFO_V1(sexp_car_func);
@@ -28,6 +37,21 @@ PG_FUNCTION_INFO_V1(sexp_length_func);
 PG_FUNCTION_INFO_V1(sexp_nth_func);
 PG_FUNCTION_INFO_V1(sexp_head_func);
 
+/* Element iteration */
+PG_FUNCTION_INFO_V1(sexp_elements);
+PG_FUNCTION_INFO_V1(sexp_elements_text);
+
+/* Path extraction */
+PG_FUNCTION_INFO_V1(sexp_extract_path);
+
+/* Typed atom accessors */
+PG_FUNCTION_INFO_V1(sexp_as_int);
+PG_FUNCTION_INFO_V1(sexp_as_float);
+PG_FUNCTION_INFO_V1(sexp_as_text);
+PG_FUNCTION_INFO_V1(sexp_as_int_path);
+PG_FUNCTION_INFO_V1(sexp_as_float_path);
+PG_FUNCTION_INFO_V1(sexp_as_text_path);
+
 /* Type inspection */
 PG_FUNCTION_INFO_V1(sexp_typeof);
 PG_FUNCTION_INFO_V1(sexp_is_nil);
@@ -43,7 +67,10 @@ PG_FUNCTION_INFO_V1(sexp_contains_key_func);
 
 /* Pattern matching */
 PG_FUNCTION_INFO_V1(sexp_match_func);
+PG_FUNCTION_INFO_V1(sexp_match_any_func);
+PG_FUNCTION_INFO_V1(sexp_match_which_func);
 PG_FUNCTION_INFO_V1(sexp_find_func);
+PG_FUNCTION_INFO_V1(sexp_find_all);
 
 /* Hash support */
 PG_FUNCTION_INFO_V1(sexp_hash);
@@ -55,10 +82,14 @@ Datum
 sexp_in(PG_FUNCTION_ARGS)
 {
     char   *input = PG_GETARG_CSTRING(0);
+    size_t  input_len = strlen(input);
     Sexp   *result;
 
-    result = sexp_parse(input, strlen(input));
-    
+    result = sexp_parse(input, input_len);
+
+    SEXP_STAT_INC(parse_calls);
+    SEXP_STAT_ADD(parse_bytes, input_len);
+
     PG_RETURN_SEXP(result);
 }
 
@@ -72,7 +103,10 @@ sexp_out(PG_FUNCTION_ARGS)
     char   *result;
 
     result = sexp_to_cstring(sexp);
-    
+
+    SEXP_STAT_INC(output_calls);
+    SEXP_STAT_ADD(output_bytes, strlen(result));
+
     PG_RETURN_CSTRING(result);
 }
 
@@ -87,11 +121,19 @@ sexp_recv(PG_FUNCTION_ARGS)
     int         nbytes;
     
     nbytes = buf->len - buf->cursor;
+
+    /*
+     * The wire bytes are untrusted (binary COPY, replication). One
+     * streaming validation pass here lets every later reader trust
+     * SEntry offsets and lengths without re-checking them.
+     */
+    sexp_validate_binary((const uint8 *) &buf->data[buf->cursor], nbytes);
+
     result = (Sexp *) palloc(nbytes + VARHDRSZ);
     SET_VARSIZE(result, nbytes + VARHDRSZ);
     memcpy(VARDATA(result), &buf->data[buf->cursor], nbytes);
     buf->cursor += nbytes;
-    
+
     PG_RETURN_SEXP(result);
 }
 
@@ -138,15 +180,79 @@ sexp_ne(PG_FUNCTION_ARGS)
     PG_RETURN_BOOL(!sexp_equal_packed(a, b));
 }
 
+/*
+ * sexp_cmp - Three-way comparison (btree support function)
+ *
+ * Canonical total ordering over the binary format; see
+ * elements_compare_recursive in sexp_ops.c for the ordering rules.
+ */
+Datum
+sexp_cmp(PG_FUNCTION_ARGS)
+{
+    struct varlena *a = PG_GETARG_SEXP_PACKED(0);
+    struct varlena *b = PG_GETARG_SEXP_PACKED(1);
+
+    PG_RETURN_INT32(sexp_compare_packed(a, b));
+}
+
+/*
+ * sexp_lt - Less-than operator
+ */
+Datum
+sexp_lt(PG_FUNCTION_ARGS)
+{
+    struct varlena *a = PG_GETARG_SEXP_PACKED(0);
+    struct varlena *b = PG_GETARG_SEXP_PACKED(1);
+
+    PG_RETURN_BOOL(sexp_compare_packed(a, b) < 0);
+}
+
+/*
+ * sexp_le - Less-than-or-equal operator
+ */
+Datum
+sexp_le(PG_FUNCTION_ARGS)
+{
+    struct varlena *a = PG_GETARG_SEXP_PACKED(0);
+    struct varlena *b = PG_GETARG_SEXP_PACKED(1);
+
+    PG_RETURN_BOOL(sexp_compare_packed(a, b) <= 0);
+}
+
+/*
+ * sexp_gt - Greater-than operator
+ */
+Datum
+sexp_gt(PG_FUNCTION_ARGS)
+{
+    struct varlena *a = PG_GETARG_SEXP_PACKED(0);
+    struct varlena *b = PG_GETARG_SEXP_PACKED(1);
+
+    PG_RETURN_BOOL(sexp_compare_packed(a, b) > 0);
+}
+
+/*
+ * sexp_ge - Greater-than-or-equal operator
+ */
+Datum
+sexp_ge(PG_FUNCTION_ARGS)
+{
+    struct varlena *a = PG_GETARG_SEXP_PACKED(0);
+    struct varlena *b = PG_GETARG_SEXP_PACKED(1);
+
+    PG_RETURN_BOOL(sexp_compare_packed(a, b) >= 0);
+}
+
 /*
  * sexp_car_func - Get first element of a list (head)
  */
 Datum
 sexp_car_func(PG_FUNCTION_ARGS)
 {
-    Sexp   *sexp = PG_GETARG_SEXP(0);
+    /* Prefix operation: fetch only the header + first element of TOASTed values */
+    Sexp   *sexp = sexp_detoast_prefix(PG_GETARG_DATUM(0));
     Sexp   *result;
-    
+
     result = sexp_car(sexp);
     if (result == NULL)
         PG_RETURN_NULL();
@@ -204,16 +310,271 @@ sexp_nth_func(PG_FUNCTION_ARGS)
 Datum
 sexp_head_func(PG_FUNCTION_ARGS)
 {
-    Sexp   *sexp = PG_GETARG_SEXP(0);
+    /* Prefix operation: fetch only the header + first element of TOASTed values */
+    Sexp   *sexp = sexp_detoast_prefix(PG_GETARG_DATUM(0));
     Sexp   *result;
-    
+
     result = sexp_head(sexp);
     if (result == NULL)
         PG_RETURN_NULL();
-    
+
+    PG_RETURN_SEXP(result);
+}
+
+/*
+ * sexp_elements - Set-returning function yielding one row per list element
+ *
+ * The iterator (symbol table decode, list header, walk position) lives in
+ * the multi-call context, so an n-element list is unnested in a single
+ * pass instead of n nth() calls each redoing the setup.
+ */
+Datum
+sexp_elements(PG_FUNCTION_ARGS)
+{
+    FuncCallContext *funcctx;
+    SexpElementsIter *iter;
+    Sexp   *elem;
+
+    if (SRF_IS_FIRSTCALL())
+    {
+        funcctx = SRF_FIRSTCALL_INIT();
+        funcctx->user_fctx = sexp_elements_iter_init(PG_GETARG_SEXP(0),
+                                                     funcctx->multi_call_memory_ctx);
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    iter = (SexpElementsIter *) funcctx->user_fctx;
+
+    elem = sexp_elements_iter_next(iter);
+    if (elem == NULL)
+        SRF_RETURN_DONE(funcctx);
+
+    SRF_RETURN_NEXT(funcctx, PointerGetDatum(elem));
+}
+
+/*
+ * sexp_elements_text - Like sexp_elements, but yields text representations
+ *
+ * Convenient for unnesting lists of atoms without casting each row.
+ */
+Datum
+sexp_elements_text(PG_FUNCTION_ARGS)
+{
+    FuncCallContext *funcctx;
+    SexpElementsIter *iter;
+    Sexp   *elem;
+
+    if (SRF_IS_FIRSTCALL())
+    {
+        funcctx = SRF_FIRSTCALL_INIT();
+        funcctx->user_fctx = sexp_elements_iter_init(PG_GETARG_SEXP(0),
+                                                     funcctx->multi_call_memory_ctx);
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    iter = (SexpElementsIter *) funcctx->user_fctx;
+
+    elem = sexp_elements_iter_next(iter);
+    if (elem == NULL)
+        SRF_RETURN_DONE(funcctx);
+
+    SRF_RETURN_NEXT(funcctx,
+                    PointerGetDatum(cstring_to_text(sexp_to_cstring(elem))));
+}
+
+/*
+ * compile_path - Build a SexpCompiledPath from a text[] in mcxt
+ *
+ * A step of all digits (optionally signed) becomes a 0-based index;
+ * anything else is a key symbol. NULL steps are rejected.
+ */
+static SexpCompiledPath *
+compile_path(ArrayType *path_arr, MemoryContext mcxt)
+{
+    SexpCompiledPath *cp;
+    Datum  *elems;
+    bool   *nulls;
+    int     nelems;
+    int     i;
+
+    deconstruct_array(path_arr, TEXTOID, -1, false, TYPALIGN_INT,
+                      &elems, &nulls, &nelems);
+
+    cp = (SexpCompiledPath *)
+        MemoryContextAlloc(mcxt, offsetof(SexpCompiledPath, steps) +
+                                 nelems * sizeof(SexpPathStep));
+    cp->nsteps = nelems;
+
+    for (i = 0; i < nelems; i++)
+    {
+        SexpPathStep *step = &cp->steps[i];
+        char   *str;
+        char   *endptr;
+        long    idx;
+
+        if (nulls[i])
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("path element %d is null", i + 1)));
+
+        str = text_to_cstring(DatumGetTextPP(elems[i]));
+
+        errno = 0;
+        idx = strtol(str, &endptr, 10);
+        if (endptr != str && *endptr == '\0' && errno == 0 &&
+            idx >= PG_INT32_MIN && idx <= PG_INT32_MAX)
+        {
+            step->is_index = true;
+            step->index = (int32) idx;
+            step->name = NULL;
+            step->name_len = 0;
+        }
+        else
+        {
+            step->is_index = false;
+            step->index = 0;
+            step->name_len = strlen(str);
+            step->name = MemoryContextAlloc(mcxt, step->name_len + 1);
+            memcpy(step->name, str, step->name_len + 1);
+        }
+
+        pfree(str);
+    }
+
+    return cp;
+}
+
+/*
+ * sexp_extract_path - Extract a nested value by path (#> operator)
+ *
+ * The path is compiled once and cached in fn_extra when it is a query
+ * constant, so repeated rows pay only for the binary-format descent.
+ */
+/*
+ * Fetch the compiled form of the text[] path in argument 1, caching it in
+ * fn_extra when the argument is a query constant so repeated rows skip
+ * recompilation.
+ */
+static SexpCompiledPath *
+get_cached_path(FunctionCallInfo fcinfo)
+{
+    SexpCompiledPath *path = NULL;
+
+    if (fcinfo->flinfo != NULL)
+    {
+        path = (SexpCompiledPath *) fcinfo->flinfo->fn_extra;
+        if (path == NULL && get_fn_expr_arg_stable(fcinfo->flinfo, 1))
+        {
+            path = compile_path(PG_GETARG_ARRAYTYPE_P(1),
+                                fcinfo->flinfo->fn_mcxt);
+            fcinfo->flinfo->fn_extra = path;
+        }
+    }
+
+    if (path == NULL)
+        path = compile_path(PG_GETARG_ARRAYTYPE_P(1), CurrentMemoryContext);
+
+    return path;
+}
+
+Datum
+sexp_extract_path(PG_FUNCTION_ARGS)
+{
+    Sexp   *sexp = PG_GETARG_SEXP(0);
+    SexpCompiledPath *path = get_cached_path(fcinfo);
+    Sexp   *result;
+
+    result = sexp_extract_path_compiled(sexp, path);
+    if (result == NULL)
+        PG_RETURN_NULL();
+
     PG_RETURN_SEXP(result);
 }
 
+/*
+ * sexp_as_int / sexp_as_float / sexp_as_text - Typed atom accessors
+ *
+ * Decode the atom straight out of the binary encoding into a native Datum,
+ * skipping the Sexp-varlena materialization and text round-trip that
+ * nth(...)::text::bigint pays. The path-taking variants reuse the #>
+ * descent and path cache. Non-matching types (and missed paths) return
+ * SQL NULL rather than erroring, so mixed-type columns scan cleanly.
+ */
+Datum
+sexp_as_int(PG_FUNCTION_ARGS)
+{
+    Sexp   *sexp = PG_GETARG_SEXP(0);
+    int64   val;
+
+    if (!sexp_path_as_int(sexp, NULL, &val))
+        PG_RETURN_NULL();
+
+    PG_RETURN_INT64(val);
+}
+
+Datum
+sexp_as_float(PG_FUNCTION_ARGS)
+{
+    Sexp   *sexp = PG_GETARG_SEXP(0);
+    double  val;
+
+    if (!sexp_path_as_float(sexp, NULL, &val))
+        PG_RETURN_NULL();
+
+    PG_RETURN_FLOAT8(val);
+}
+
+Datum
+sexp_as_text(PG_FUNCTION_ARGS)
+{
+    Sexp   *sexp = PG_GETARG_SEXP(0);
+    text   *result = sexp_path_as_text(sexp, NULL);
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_TEXT_P(result);
+}
+
+Datum
+sexp_as_int_path(PG_FUNCTION_ARGS)
+{
+    Sexp   *sexp = PG_GETARG_SEXP(0);
+    SexpCompiledPath *path = get_cached_path(fcinfo);
+    int64   val;
+
+    if (!sexp_path_as_int(sexp, path, &val))
+        PG_RETURN_NULL();
+
+    PG_RETURN_INT64(val);
+}
+
+Datum
+sexp_as_float_path(PG_FUNCTION_ARGS)
+{
+    Sexp   *sexp = PG_GETARG_SEXP(0);
+    SexpCompiledPath *path = get_cached_path(fcinfo);
+    double  val;
+
+    if (!sexp_path_as_float(sexp, path, &val))
+        PG_RETURN_NULL();
+
+    PG_RETURN_FLOAT8(val);
+}
+
+Datum
+sexp_as_text_path(PG_FUNCTION_ARGS)
+{
+    Sexp   *sexp = PG_GETARG_SEXP(0);
+    SexpCompiledPath *path = get_cached_path(fcinfo);
+    text   *result = sexp_path_as_text(sexp, path);
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_TEXT_P(result);
+}
+
 /*
  * sexp_typeof - Get type name of sexp
  * 
@@ -222,9 +583,18 @@ sexp_head_func(PG_FUNCTION_ARGS)
 Datum
 sexp_typeof(PG_FUNCTION_ARGS)
 {
-    struct varlena *packed = PG_GETARG_SEXP_PACKED(0);
+    struct varlena *packed;
     const char *typename;
-    
+
+    /*
+     * Prefix operation: the type lives in the first element's tag byte, so
+     * TOASTed values only need a header slice, not a full detoast.
+     */
+    if (VARATT_IS_EXTERNAL_ONDISK(DatumGetPointer(PG_GETARG_DATUM(0))))
+        packed = (struct varlena *) sexp_detoast_prefix(PG_GETARG_DATUM(0));
+    else
+        packed = PG_GETARG_SEXP_PACKED(0);
+
     switch (SEXP_TYPE_PACKED(packed))
     {
         case SEXP_NIL:
@@ -304,47 +674,211 @@ sexp_is_number(PG_FUNCTION_ARGS)
     PG_RETURN_BOOL(t == SEXP_INTEGER || t == SEXP_FLOAT);
 }
 
+/*
+ * get_cached_needle - Fetch or build the compiled needle for argument 1
+ *
+ * When the needle argument is stable for the life of the scan (the usual
+ * "expr @> constant" shape), compile it once into fn_mcxt and cache the
+ * result in fn_extra so subsequent rows skip all needle-side setup.
+ * Returns NULL when no caching is possible (e.g. DirectFunctionCall with
+ * no flinfo, or a needle that varies per row).
+ */
+static SexpCompiledNeedle *
+get_cached_needle(FunctionCallInfo fcinfo)
+{
+    SexpCompiledNeedle *needle;
+
+    if (fcinfo->flinfo == NULL)
+        return NULL;
+
+    needle = (SexpCompiledNeedle *) fcinfo->flinfo->fn_extra;
+    if (needle == NULL && get_fn_expr_arg_stable(fcinfo->flinfo, 1))
+    {
+        struct varlena *packed = PG_GETARG_SEXP_PACKED(1);
+
+        needle = sexp_needle_compile(packed, fcinfo->flinfo->fn_mcxt);
+        fcinfo->flinfo->fn_extra = needle;
+    }
+
+    return needle;
+}
+
 /*
  * sexp_contains_func - Check if container contains element (structural)
- * 
- * OPTIMIZED: Uses packed varlena to avoid unnecessary detoasting copy.
+ *
+ * OPTIMIZED: Uses packed varlena to avoid unnecessary detoasting copy,
+ * and caches a compiled needle in fn_extra when the element is a query
+ * constant, so per-row work is the container traversal only.
  */
 Datum
 sexp_contains_func(PG_FUNCTION_ARGS)
 {
     struct varlena *container = PG_GETARG_SEXP_PACKED(0);
-    struct varlena *element = PG_GETARG_SEXP_PACKED(1);
-    
-    PG_RETURN_BOOL(sexp_contains_packed(container, element));
+    SexpCompiledNeedle *needle = get_cached_needle(fcinfo);
+
+    if (needle != NULL)
+        PG_RETURN_BOOL(sexp_contains_compiled(container, needle));
+
+    PG_RETURN_BOOL(sexp_contains_packed(container,
+                                        PG_GETARG_SEXP_PACKED(1)));
 }
 
 /*
  * sexp_contains_key_func - Check if container contains element (key-based)
- * 
+ *
  * Key-based containment (@>>) treats list heads as "keys" and matches
- * remaining elements in any order, similar to jsonb @>.
+ * remaining elements in any order, similar to jsonb @>. Uses the same
+ * compiled-needle cache as sexp_contains_func.
  */
 Datum
 sexp_contains_key_func(PG_FUNCTION_ARGS)
 {
     Sexp   *container = PG_GETARG_SEXP(0);
-    Sexp   *needle = PG_GETARG_SEXP(1);
-    
-    PG_RETURN_BOOL(sexp_contains_key(container, needle));
+    SexpCompiledNeedle *needle = get_cached_needle(fcinfo);
+
+    if (needle != NULL)
+        PG_RETURN_BOOL(sexp_contains_key_compiled(container, needle));
+
+    PG_RETURN_BOOL(sexp_contains_key(container, PG_GETARG_SEXP(1)));
 }
 
 /*
  * sexp_match_func - Pattern matching (SQL wrapper)
+ *
+ * When the pattern is a query constant it is compiled once into an
+ * instruction array cached in fn_extra (see sexp_pattern_compile), so
+ * per-row matching never re-decodes the pattern.
  */
 Datum
 sexp_match_func(PG_FUNCTION_ARGS)
 {
     Sexp   *expr = PG_GETARG_SEXP(0);
-    Sexp   *pattern = PG_GETARG_SEXP(1);
-    
+    Sexp   *pattern;
+
+    if (fcinfo->flinfo != NULL)
+    {
+        SexpCompiledPattern *cp =
+            (SexpCompiledPattern *) fcinfo->flinfo->fn_extra;
+
+        if (cp == NULL && get_fn_expr_arg_stable(fcinfo->flinfo, 1))
+        {
+            cp = sexp_pattern_compile(PG_GETARG_SEXP(1),
+                                      fcinfo->flinfo->fn_mcxt);
+            fcinfo->flinfo->fn_extra = cp;
+        }
+
+        if (cp != NULL)
+            PG_RETURN_BOOL(sexp_match_compiled(expr, cp));
+    }
+
+    pattern = PG_GETARG_SEXP(1);
     PG_RETURN_BOOL(sexp_match(expr, pattern));
 }
 
+/*
+ * compile_pattern_set - Build a SexpMultiPattern from a sexp[] in mcxt
+ *
+ * NULL array elements are rejected: sexp_match_which reports 1-based
+ * positions into the original array, so patterns cannot silently drop out.
+ */
+static SexpMultiPattern *
+compile_pattern_set(ArrayType *pat_arr, MemoryContext mcxt)
+{
+    Datum  *elems;
+    bool   *nulls;
+    int     nelems;
+    Sexp  **patterns;
+    SexpMultiPattern *mp;
+    int     i;
+
+    deconstruct_array(pat_arr, ARR_ELEMTYPE(pat_arr), -1, false, TYPALIGN_INT,
+                      &elems, &nulls, &nelems);
+
+    patterns = palloc(sizeof(Sexp *) * Max(nelems, 1));
+    for (i = 0; i < nelems; i++)
+    {
+        if (nulls[i])
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("pattern %d is null", i + 1)));
+        patterns[i] = DatumGetSexp(elems[i]);
+    }
+
+    mp = sexp_multi_pattern_compile(patterns, nelems, mcxt);
+    pfree(patterns);
+    return mp;
+}
+
+/*
+ * get_cached_pattern_set - Fetch or build the compiled set for argument 1
+ *
+ * Same fn_extra discipline as the single-pattern and needle caches: when
+ * the pattern array is a query constant, the whole set (including its
+ * head-symbol dispatch table) is compiled once per scan.
+ */
+static SexpMultiPattern *
+get_cached_pattern_set(FunctionCallInfo fcinfo)
+{
+    SexpMultiPattern *mp = NULL;
+
+    if (fcinfo->flinfo != NULL)
+    {
+        mp = (SexpMultiPattern *) fcinfo->flinfo->fn_extra;
+        if (mp == NULL && get_fn_expr_arg_stable(fcinfo->flinfo, 1))
+        {
+            mp = compile_pattern_set(PG_GETARG_ARRAYTYPE_P(1),
+                                     fcinfo->flinfo->fn_mcxt);
+            fcinfo->flinfo->fn_extra = mp;
+        }
+    }
+
+    if (mp == NULL)
+        mp = compile_pattern_set(PG_GETARG_ARRAYTYPE_P(1),
+                                 CurrentMemoryContext);
+
+    return mp;
+}
+
+/*
+ * sexp_match_any_func - Does any pattern in the array match? (SQL wrapper)
+ *
+ * One call replaces a chain of per-pattern @~ tests: the document's head
+ * symbol is decoded once and dispatched against the compiled set, so
+ * patterns anchored on other head symbols cost nothing per row.
+ */
+Datum
+sexp_match_any_func(PG_FUNCTION_ARGS)
+{
+    Sexp   *expr = PG_GETARG_SEXP(0);
+    SexpMultiPattern *mp = get_cached_pattern_set(fcinfo);
+
+    PG_RETURN_BOOL(sexp_match_any_multi(expr, mp));
+}
+
+/*
+ * sexp_match_which_func - 1-based indices of matching patterns (SQL wrapper)
+ */
+Datum
+sexp_match_which_func(PG_FUNCTION_ARGS)
+{
+    Sexp   *expr = PG_GETARG_SEXP(0);
+    SexpMultiPattern *mp = get_cached_pattern_set(fcinfo);
+    int    *which;
+    Datum  *datums;
+    int     count;
+    int     i;
+
+    which = palloc(sizeof(int) * Max(mp->npatterns, 1));
+    count = sexp_match_which_multi(expr, mp, which);
+
+    datums = palloc(sizeof(Datum) * Max(count, 1));
+    for (i = 0; i < count; i++)
+        datums[i] = Int32GetDatum(which[i]);
+
+    PG_RETURN_ARRAYTYPE_P(construct_array(datums, count, INT4OID,
+                                          sizeof(int32), true, TYPALIGN_INT));
+}
+
 /*
  * sexp_find_func - Find first matching subexpression (SQL wrapper)
  */
@@ -356,13 +890,51 @@ sexp_find_func(PG_FUNCTION_ARGS)
     Sexp   *result;
     
     result = sexp_find_first(expr, pattern);
-    
+
     if (result == NULL)
         PG_RETURN_NULL();
-    
+
     PG_RETURN_SEXP(result);
 }
 
+/*
+ * sexp_find_all - Stream every subexpression matching pattern (SRF)
+ *
+ * One recursive traversal on the first call collects all matches into
+ * the multi-call context; subsequent calls just hand out the results.
+ * The optional third argument caps the number of matches returned.
+ */
+Datum
+sexp_find_all(PG_FUNCTION_ARGS)
+{
+    FuncCallContext *funcctx;
+    Sexp  **items;
+
+    if (SRF_IS_FIRSTCALL())
+    {
+        int32 max_results = 0;
+
+        funcctx = SRF_FIRSTCALL_INIT();
+
+        if (PG_NARGS() > 2 && !PG_ARGISNULL(2))
+            max_results = PG_GETARG_INT32(2);
+
+        funcctx->max_calls =
+            sexp_find_all_collect(PG_GETARG_SEXP(0), PG_GETARG_SEXP(1),
+                                  max_results,
+                                  funcctx->multi_call_memory_ctx, &items);
+        funcctx->user_fctx = items;
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    items = (Sexp **) funcctx->user_fctx;
+
+    if (funcctx->call_cntr < funcctx->max_calls)
+        SRF_RETURN_NEXT(funcctx, PointerGetDatum(items[funcctx->call_cntr]));
+
+    SRF_RETURN_DONE(funcctx);
+}
+
 /*
  * sexp_hash - Semantic hash function for hash indexes and joins
  *
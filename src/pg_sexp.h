@@ -15,12 +15,23 @@
  * OPTIMIZED BINARY FORMAT:
  * ========================
  *
- * Root structure:
- *   [1 byte: version]                  -- SEXP_FORMAT_VERSION
+ * Root structure (version 7):
+ *   [1 byte: version]                  -- SEXP_FORMAT_VERSION + flag bits
+ *   [uint32: root_hash]                -- structural hash of root element
+ *   [1/2/4 x uint64: root_bloom]       -- Bloom signature of root element
+ *                                         (width in the version byte's
+ *                                         SEXP_FLAG_BLOOM_WIDTH bits)
  *   [varint: symbol_count]
  *   [symbol_table: symbol_count entries]
  *   [root_element]
  *
+ * The root hash/Bloom header makes sexp_hash, equality fast-rejection and
+ * the Bloom pre-check in containment O(1) header reads for every value,
+ * including atoms and small-list roots that have no stored list hash.
+ * Version-6 values (no root header) are still readable; internally built
+ * sub-expressions (car, nth, match captures) are emitted as version 6 to
+ * avoid recomputing metadata for throwaway values.
+ *
  * Symbol table entry:
  *   [varint: length]
  *   [bytes: symbol chars]
@@ -82,8 +93,63 @@
 #include "lib/stringinfo.h"
 #include "common/hashfn.h"
 
-/* Binary format version - small lists include size prefix for O(1) skipping */
-#define SEXP_FORMAT_VERSION 6
+/* Binary format version - adds root hash/Bloom header (v7) on top of the
+ * v6 small-list size prefixes */
+#define SEXP_FORMAT_VERSION 7
+
+/* Previous version, still written for internally extracted sub-expressions */
+#define SEXP_FORMAT_VERSION_V6 6
+
+/* Does this version byte carry the root metadata header? */
+#define SEXP_VERSION_HAS_ROOT_META(v) (((v) & 0x0F) >= 7)
+
+/*
+ * Version byte flags (high nibble). The low nibble is the format version.
+ *
+ * SEXP_FLAG_DICT_SYMTAB marks a value whose symbol table stores shared
+ * dictionary IDs (varints referencing the pg_sexp_dictionary table)
+ * instead of inline symbol strings. Readers resolve the IDs through the
+ * per-backend dictionary cache (sexp_dict.c). Written only when the
+ * pg_sexp.use_symbol_dictionary GUC is on and every symbol in the value
+ * is present in the dictionary; otherwise the inline table is kept, so
+ * writes never depend on the dictionary being complete.
+ *
+ * SEXP_FLAG_BLOOM_WIDTH is a two-bit field selecting the root Bloom
+ * signature width: code 0/1/2 = 1/2/4 uint64 words (64/128/256 bits);
+ * code 3 is reserved and rejected by validation. A 64-bit signature
+ * saturates above a few dozen distinct elements, so the writer widens it
+ * with the document's element count (see SEXP_BLOOM_128_THRESHOLD). Bit
+ * positions are assigned so that wider signatures fold down to narrower
+ * ones by ORing words, which keeps mixed-width comparisons exact.
+ */
+#define SEXP_FLAG_DICT_SYMTAB  0x10
+#define SEXP_FLAG_BLOOM_WIDTH  0x60
+#define SEXP_BLOOM_WIDTH_SHIFT 5
+#define SEXP_KNOWN_FLAGS       (SEXP_FLAG_DICT_SYMTAB | SEXP_FLAG_BLOOM_WIDTH)
+
+#define SEXP_VERSION_HAS_DICT(v) (((v) & SEXP_FLAG_DICT_SYMTAB) != 0)
+
+/* Number of uint64 Bloom words encoded in a version byte (1, 2, 4 or 8;
+ * 8 means the reserved width code 3 and never passes validation) */
+#define SEXP_BLOOM_NWORDS(v) \
+    (1 << (((v) & SEXP_FLAG_BLOOM_WIDTH) >> SEXP_BLOOM_WIDTH_SHIFT))
+#define SEXP_BLOOM_MAX_WORDS 4
+
+/* Element counts above which the writer widens the root Bloom signature */
+#define SEXP_BLOOM_128_THRESHOLD 32
+#define SEXP_BLOOM_256_THRESHOLD 96
+
+/* Size of the v7 root metadata header for a version byte:
+ * uint32 hash + the version's Bloom words */
+#define SEXP_ROOT_META_SIZE_V(v) \
+    (sizeof(uint32) + SEXP_BLOOM_NWORDS(v) * sizeof(uint64))
+
+/* A widened Bloom signature: nwords valid entries in words[] */
+typedef struct SexpWideBloom
+{
+    int     nwords;
+    uint64  words[SEXP_BLOOM_MAX_WORDS];
+} SexpWideBloom;
 
 /* Type tags (3 bits, stored in bits 7-5 for atoms, or in SEntry for list elements) */
 #define SEXP_TAG_NIL          0x00  /* 000 */
@@ -249,6 +315,40 @@ typedef struct SexpSymbolTable
     int         hash_mask;      /* hash_size - 1, for fast modulo */
 } SexpSymbolTable;
 
+/* Symbol table management (sexp_parser.c) - shared with other builders */
+extern void sexp_symtab_init(SexpSymbolTable *tab);
+extern void sexp_symtab_free(SexpSymbolTable *tab);
+extern int sexp_symtab_intern(SexpSymbolTable *tab, const char *sym, int len);
+
+/*
+ * Re-encode one element into a new symbol-table namespace (sexp_expanded.c).
+ * Copies the element at *pp into 'out', interning referenced symbols into
+ * 'symtab' and rewriting SYMBOL_REF indices; advances *pp and returns the
+ * element's structural hash. Used by builders that merge values whose
+ * symbol tables differ, such as the expanded (mutable) representation.
+ */
+extern uint32 sexp_reencode_element(StringInfo out, uint8 **pp, uint8 *end,
+                                    char **symbols, int *sym_lengths,
+                                    int sym_count, SexpSymbolTable *symtab,
+                                    int depth);
+
+/*
+ * Shared symbol dictionary (sexp_dict.c)
+ * =======================================
+ *
+ * Schema-heavy tables repeat the same few hundred symbols in every value's
+ * inline symbol table. When pg_sexp.use_symbol_dictionary is on and all of
+ * a value's symbols exist in the pg_sexp_dictionary table, the writer
+ * stores dictionary IDs instead of strings (SEXP_FLAG_DICT_SYMTAB) and
+ * readers resolve them through a per-backend cache loaded with SPI on
+ * first use. Unknown IDs force one cache reload before erroring, so
+ * freshly added dictionary entries become visible without reconnecting.
+ */
+extern bool sexp_dict_enabled;
+extern bool sexp_dict_id_for(const char *sym, int len, int32 *id_out);
+extern char *sexp_dict_resolve(int32 id, int *len_out, uint32 *hash_out);
+extern void sexp_dict_invalidate(void);
+
 typedef struct SexpParseState
 {
     const char      *input;     /* Input string */
@@ -280,6 +380,10 @@ typedef struct SexpReadState
     char        *stack_symbols[SEXP_SMALL_SYMTAB_SIZE];   /* Stack-allocated for small tables */
     int          stack_lengths[SEXP_SMALL_SYMTAB_SIZE];   /* Stack-allocated for small tables */
     uint32       stack_hashes[SEXP_SMALL_SYMTAB_SIZE];    /* Stack-allocated for small tables */
+    bool         has_root_meta; /* True for v7 values with root hash/Bloom */
+    uint32       root_hash;     /* Stored structural hash (v7 only) */
+    uint64       root_bloom;    /* Stored signature folded to 64 bits (v7) */
+    SexpWideBloom root_bloom_wide; /* Stored signature at full width (v7) */
 } SexpReadState;
 
 /* Maximum nesting depth to prevent stack overflow */
@@ -557,6 +661,99 @@ bloom_from_gin_keys(int32 lo_key, int32 hi_key)
     return ((BloomSig)(uint32)hi_key << 32) | (BloomSig)(uint32)lo_key;
 }
 
+/*
+ * Wide Bloom signatures (SexpWideBloom)
+ * -------------------------------------
+ * Bit positions are the same rotations bloom_compute_sig uses, masked to
+ * the signature width instead of 63. Since all widths are powers of two,
+ * a wide position p maps to p mod 64 after folding words together with
+ * OR - exactly the bit the 64-bit computation would have set. Folding is
+ * therefore lossless down-conversion, and two signatures of different
+ * widths are compared by folding both to the narrower one.
+ */
+
+static inline void
+bloom_wide_init(SexpWideBloom *sig, int nwords)
+{
+    int i;
+
+    sig->nwords = nwords;
+    for (i = 0; i < SEXP_BLOOM_MAX_WORDS; i++)
+        sig->words[i] = 0;
+}
+
+/* Add one element hash to a wide signature */
+static inline void
+bloom_wide_add(SexpWideBloom *sig, uint32 elem_hash)
+{
+    int mask = sig->nwords * 64 - 1;
+    int i;
+
+    for (i = 0; i < BLOOM_K; i++)
+    {
+        uint32 rotated = rotl32(elem_hash, i * 8);
+        int bit_pos = rotated & mask;
+
+        sig->words[bit_pos >> 6] |= ((uint64)1 << (bit_pos & 63));
+    }
+}
+
+/* Fold a wide signature down to nwords (Bloom union of the word groups) */
+static inline void
+bloom_wide_fold(SexpWideBloom *sig, int nwords)
+{
+    int i;
+
+    for (i = nwords; i < sig->nwords; i++)
+    {
+        sig->words[i & (nwords - 1)] |= sig->words[i];
+        sig->words[i] = 0;
+    }
+    sig->nwords = nwords;
+}
+
+/*
+ * Wide-signature version of bloom_may_contain. Both signatures are
+ * compared at the narrower of the two widths; same maybe/definitely-not
+ * semantics as the 64-bit test.
+ */
+static inline bool
+bloom_wide_may_contain(const SexpWideBloom *container, const SexpWideBloom *needle)
+{
+    SexpWideBloom c = *container;
+    SexpWideBloom n = *needle;
+    int nwords = Min(c.nwords, n.nwords);
+    int i;
+
+    bloom_wide_fold(&c, nwords);
+    bloom_wide_fold(&n, nwords);
+
+    for (i = 0; i < nwords; i++)
+    {
+        if ((n.words[i] & ~c.words[i]) != 0)
+            return false;
+    }
+    return true;
+}
+
+/* Bloom word count for a document with this many elements */
+static inline int
+bloom_words_for_count(int elem_count)
+{
+    if (elem_count > SEXP_BLOOM_256_THRESHOLD)
+        return 4;
+    if (elem_count > SEXP_BLOOM_128_THRESHOLD)
+        return 2;
+    return 1;
+}
+
+/* Version-byte width code for a word count (inverse of SEXP_BLOOM_NWORDS) */
+static inline int
+bloom_width_code(int nwords)
+{
+    return (nwords == 4) ? 2 : nwords - 1;
+}
+
 /* Function declarations - Parser */
 extern Sexp *sexp_parse(const char *input, int len);
 extern void sexp_parse_value(SexpParseState *state);
@@ -575,16 +772,120 @@ extern bool sexp_contains(Sexp *container, Sexp *element);
 extern bool sexp_contains_key(Sexp *container, Sexp *needle);
 extern Sexp *sexp_head(Sexp *sexp);
 extern uint32 sexp_compute_hash(Sexp *sexp);
+
+/*
+ * Prefix-sliced detoast for operations that only read the header, symbol
+ * table and first element (car/head/typeof). For external on-disk values
+ * this fetches a TOAST slice covering just those bytes instead of
+ * detoasting the whole document; other values detoast normally. The
+ * returned Sexp may be truncated after the first root element and must
+ * only be used with prefix operations.
+ */
+extern Sexp *sexp_detoast_prefix(Datum value);
+
+/*
+ * Persistent element iterator for set-returning functions. Lives in the
+ * SRF's multi-call memory context; the symbol table is decoded once and
+ * the element data is walked sequentially. The embedded read state may
+ * point into its own stack arrays, so the structure must not be moved.
+ */
+typedef struct SexpElementsIter
+{
+    Sexp         *sexp;         /* long-lived copy of the input */
+    SexpReadState state;        /* read state over the copy */
+    uint64        count;        /* number of elements */
+    uint64        next;         /* index of the next element to yield */
+    uint8        *cur;          /* start of the next element */
+} SexpElementsIter;
+
+extern SexpElementsIter *sexp_elements_iter_init(Sexp *sexp, MemoryContext mcxt);
+extern Sexp *sexp_elements_iter_next(SexpElementsIter *it);
+
+/*
+ * Compiled extraction paths (sexp_extract_path / #>)
+ * ==================================================
+ *
+ * A path is an array of text steps compiled once (and cached in fn_extra
+ * when the path is a query constant). An integer-looking step selects the
+ * nth element of the current list, 0-indexed. Any other step is a key:
+ * it selects the first child list whose head symbol equals the step, then
+ * descends into that list's value - for the common (key value) pair shape
+ * the value element itself, otherwise the whole keyed list so that
+ * further steps (including indexes) can continue from it.
+ *
+ * The descent runs over the binary format using SEntry offsets where
+ * available and materializes only the final leaf.
+ */
+typedef struct SexpPathStep
+{
+    bool        is_index;       /* numeric step? */
+    int32       index;          /* 0-based element index when is_index */
+    char       *name;           /* key symbol text otherwise */
+    int         name_len;
+} SexpPathStep;
+
+typedef struct SexpCompiledPath
+{
+    int         nsteps;
+    SexpPathStep steps[FLEXIBLE_ARRAY_MEMBER];
+} SexpCompiledPath;
+
+extern Sexp *sexp_extract_path_compiled(Sexp *sexp, SexpCompiledPath *path);
+
+/* Typed leaf extraction (sexp_as_int / sexp_as_float / sexp_as_text);
+ * NULL path reads the root element */
+extern bool sexp_path_as_int(Sexp *sexp, SexpCompiledPath *path, int64 *out);
+extern bool sexp_path_as_float(Sexp *sexp, SexpCompiledPath *path, double *out);
+extern text *sexp_path_as_text(Sexp *sexp, SexpCompiledPath *path);
+
 extern uint32 sexp_element_hash(uint8 *ptr, uint8 *end, char **symbols, int *sym_lengths, int sym_count);
 
 /* Packed varlena variants for read-only operations (avoid detoast copy) */
 extern bool sexp_equal_packed(struct varlena *a, struct varlena *b);
 extern bool sexp_contains_packed(struct varlena *container, struct varlena *element);
+extern int32 sexp_compare_packed(struct varlena *a, struct varlena *b);
 extern uint32 sexp_compute_hash_packed(struct varlena *packed);
 
+/*
+ * Compiled needle for containment operators
+ * =========================================
+ *
+ * In "WHERE expr @> '(...)'::sexp" the needle is the same constant for
+ * every row, yet the plain entry points re-decode its symbol table and
+ * re-derive its hash and Bloom signature per call. A compiled needle
+ * captures all of that once: a long-lived copy of the needle bytes, a
+ * decoded read state over them, and the precomputed fingerprints. The
+ * per-row cost then reduces to the container-side traversal.
+ *
+ * The structure and everything it references live in the memory context
+ * passed to sexp_needle_compile (typically flinfo->fn_mcxt, with the
+ * pointer stashed in fn_extra). The embedded read state may point into
+ * its own stack arrays, so the structure must not be moved after compile.
+ */
+typedef struct SexpCompiledNeedle
+{
+    SexpReadState state;        /* read state over the cached needle copy */
+    uint8        first_byte;    /* leading tag byte of the needle element */
+    uint8        tag;           /* first_byte & SEXP_TAG_MASK */
+    uint32       stype;         /* SEntry type class, for type filtering */
+    uint32       hash;          /* precomputed structural hash */
+    BloomSig     bloom;         /* precomputed Bloom signature */
+    bool         empty;         /* degenerate empty needle (never contained) */
+} SexpCompiledNeedle;
+
+extern SexpCompiledNeedle *sexp_needle_compile(struct varlena *needle,
+                                               MemoryContext mcxt);
+extern bool sexp_contains_compiled(struct varlena *container,
+                                   SexpCompiledNeedle *needle);
+extern bool sexp_contains_key_compiled(Sexp *container,
+                                       SexpCompiledNeedle *needle);
+
 /* Function declarations - Bloom signature */
 extern BloomSig sexp_compute_bloom(Sexp *sexp);
 extern BloomSig sexp_element_bloom(uint8 *ptr, uint8 *end, char **symbols, int *sym_lengths, int sym_count);
+extern int sexp_element_bloom_acc(uint8 *ptr, uint8 *end, char **symbols,
+                                  int *sym_lengths, int sym_count,
+                                  SexpWideBloom *acc);
 
 /*
  * Pattern Matching
@@ -634,10 +935,90 @@ typedef struct SexpMatchResult
     SexpCapture captures[SEXP_MAX_CAPTURES];
 } SexpMatchResult;
 
+/*
+ * Compiled patterns
+ * =================
+ *
+ * sexp_match interprets the pattern's binary form on every call: it
+ * re-decodes the pattern symbol table and re-classifies each element as
+ * wildcard/capture/literal per row. A compiled pattern hoists all of that
+ * into a flat instruction array built once (and cached in fn_extra when
+ * the pattern is a query constant); the executor then runs it against the
+ * expression's read state with no pattern-side decoding at all.
+ *
+ * Instructions are laid out pre-order: a list emits SPAT_OP_LIST_BEGIN
+ * followed by its children's instructions. Wildcards and captures both
+ * compile to SPAT_OP_ANY (captures are not extracted during matching);
+ * rest patterns compile to SPAT_OP_REST and are only legal as the last
+ * child of a list, exactly as in the interpreted matcher.
+ */
+typedef enum SexpPatOp
+{
+    SPAT_OP_LIT_NIL,        /* literal nil */
+    SPAT_OP_LIT_SMALLINT,   /* literal small integer (tag_byte holds value) */
+    SPAT_OP_LIT_INTEGER,    /* literal integer (uval = raw varint payload) */
+    SPAT_OP_LIT_FLOAT,      /* literal float (fval) */
+    SPAT_OP_LIT_SYMBOL,     /* literal symbol (str/str_len = resolved text) */
+    SPAT_OP_LIT_STRING,     /* literal string (str/str_len; pat_tag = encoding) */
+    SPAT_OP_ANY,            /* _ or ?name: match any single element */
+    SPAT_OP_REST,           /* _* or ??name: match all remaining elements */
+    SPAT_OP_LIST_BEGIN      /* list with nelems pattern children following */
+} SexpPatOp;
+
+typedef struct SexpPatInstr
+{
+    SexpPatOp   op;
+    uint8       pat_tag;        /* original tag bits (string encoding check) */
+    uint8       tag_byte;       /* full tag byte for smallint literals */
+    uint64      uval;           /* raw varint payload for integer literals */
+    float8      fval;           /* value for float literals */
+    char       *str;            /* symbol text / string bytes */
+    int         str_len;
+    uint32      nelems;         /* LIST_BEGIN: number of pattern children */
+} SexpPatInstr;
+
+typedef struct SexpCompiledPattern
+{
+    int          ninstrs;
+    SexpPatInstr *instrs;
+} SexpCompiledPattern;
+
+/*
+ * A compiled pattern set for multi-pattern classification (sexp_match_any
+ * and sexp_match_which). Patterns whose root is a list starting with a
+ * literal symbol are indexed by that head symbol in a small dispatch
+ * table, so a document only runs the patterns that could match its head;
+ * patterns without a literal head anchor chain off unanchored_head and
+ * run unconditionally. Chains link through chain_next (-1 terminates).
+ */
+typedef struct SexpMultiPattern
+{
+    int          npatterns;
+    SexpCompiledPattern **patterns;
+    const char **anchor_syms;   /* head anchor text per pattern, or NULL */
+    int         *anchor_lens;
+    uint32      *anchor_hashes; /* hash_bytes of anchor (matches sym_hashes) */
+    int         *chain_next;    /* next pattern in the same chain, -1 = end */
+    int         *buckets;       /* dispatch table of chain heads, -1 = empty */
+    int          nbuckets;      /* power of two */
+    int          unanchored_head;
+    bool        *matched;       /* per-pattern scratch for sexp_match_which */
+} SexpMultiPattern;
+
 /* Function declarations - Pattern matching */
 extern bool sexp_match(Sexp *expr, Sexp *pattern);
 extern bool sexp_match_with_captures(Sexp *expr, Sexp *pattern, SexpMatchResult *result);
 extern Sexp *sexp_find_first(Sexp *expr, Sexp *pattern);
+extern int sexp_find_all_collect(Sexp *expr, Sexp *pattern, int32 max_results,
+                                 MemoryContext mcxt, Sexp ***items);
+extern SexpCompiledPattern *sexp_pattern_compile(Sexp *pattern, MemoryContext mcxt);
+extern bool sexp_match_compiled(Sexp *expr, SexpCompiledPattern *pattern);
+extern bool sexp_symbol_is_pattern(const char *sym, int len);
+extern SexpMultiPattern *sexp_multi_pattern_compile(Sexp **patterns,
+                                                    int npatterns,
+                                                    MemoryContext mcxt);
+extern bool sexp_match_any_multi(Sexp *expr, SexpMultiPattern *mp);
+extern int sexp_match_which_multi(Sexp *expr, SexpMultiPattern *mp, int *which);
 
 /* Function declarations - Read state management */
 extern void sexp_init_read_state(SexpReadState *state, Sexp *sexp);
@@ -647,9 +1028,35 @@ extern SexpType sexp_read_type(SexpReadState *state);
 extern SexpType sexp_get_type(Sexp *sexp);
 extern SexpType sexp_get_type_packed(struct varlena *packed);
 
+/* Function declarations - Binary input validation */
+extern void sexp_validate_binary(const uint8 *data, int len);
+
 /* Function declarations - Element navigation */
 extern uint8 *sexp_skip_element(uint8 *ptr, uint8 *end);
 
+/*
+ * GIN strategy numbers (shared between the operator class in sexp_gin.c
+ * and the selectivity estimators in sexp_selfuncs.c).
+ */
+#define SEXP_GIN_CONTAINS_STRATEGY     7   /* @> structural containment */
+#define SEXP_GIN_CONTAINED_STRATEGY    8   /* <@ contained by */
+#define SEXP_GIN_CONTAINS_KEY_STRATEGY 9   /* @>> key-based containment */
+#define SEXP_GIN_MATCHES_STRATEGY      10  /* @~ pattern match */
+
+/*
+ * Number of GIN keys a query value produces under the given strategy
+ * (sexp_gin.c). The selectivity estimators use this as the query's
+ * specificity so they share the index's exact key definition.
+ */
+extern int sexp_gin_query_key_count(Sexp *query, int strategy);
+
+/*
+ * Assemble a flat Sexp from a built root element and its symbol table,
+ * with v7 root hash/Bloom metadata (sexp_build.c). Shared by the typed
+ * constructors and the sexp_agg aggregate.
+ */
+extern Sexp *sexp_build_result(StringInfo element_buf, SexpSymbolTable *symtab);
+
 /*
  * Singleton NIL allocation
  * ========================
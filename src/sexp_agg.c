@@ -0,0 +1,390 @@
+/*
+ * sexp_agg.c
+ *
+ * Native list-building aggregate: sexp_agg(sexp).
+ *
+ * Reconstructing lists from relational rows with string_agg(...)::sexp
+ * renders every element to text and then pays the full tokenizer per
+ * group, single-threaded. The aggregate below appends each input's binary
+ * encoding into a growing transition buffer through the shared re-encoder
+ * (sexp_reencode_element), merging symbol tables incrementally - the same
+ * accumulation scheme as the expanded object in sexp_expanded.c, minus the
+ * expanded-object header. Combine, serialize and deserialize support lets
+ * it run under parallel query: workers accumulate partial lists and the
+ * leader splices them together by re-encoding, which is cheap because only
+ * symbol indices need remapping.
+ *
+ * NULL inputs become nil elements, matching sexp_build_list. An aggregate
+ * over zero rows returns NULL, matching the built-in aggregates.
+ */
+
+#include "pg_sexp.h"
+#include "sexp_debug.h"
+#include <string.h>
+
+PG_FUNCTION_INFO_V1(sexp_agg_transfn);
+PG_FUNCTION_INFO_V1(sexp_agg_finalfn);
+PG_FUNCTION_INFO_V1(sexp_agg_combinefn);
+PG_FUNCTION_INFO_V1(sexp_agg_serialfn);
+PG_FUNCTION_INFO_V1(sexp_agg_deserialfn);
+
+/*
+ * Transition state: the top-level elements of the list under construction,
+ * concatenated in re-encoded form with a shared interned symbol table.
+ * Same layout as ExpandedSexp's accumulation fields; everything is
+ * allocated in the aggregate context.
+ */
+typedef struct SexpAggState
+{
+    SexpSymbolTable symtab;         /* interned symbols shared by all elements */
+    StringInfoData  elems;          /* concatenated re-encoded element data */
+    SEntry         *sentries;       /* type + offset of each top-level element */
+    uint32         *child_hashes;   /* structural hash of each element */
+    int             nelems;         /* number of top-level elements */
+    int             capacity;       /* allocated entries in the arrays above */
+} SexpAggState;
+
+/*
+ * Map an element's first byte to its SEntry type class.
+ * (Same mapping as the parser's private helper.)
+ */
+static uint32
+get_sentry_type_from_tag(uint8 tag_byte)
+{
+    uint8 tag = tag_byte & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+            return SENTRY_TYPE_NIL;
+        case SEXP_TAG_SMALLINT:
+        case SEXP_TAG_INTEGER:
+            return SENTRY_TYPE_INTEGER;
+        case SEXP_TAG_FLOAT:
+            return SENTRY_TYPE_FLOAT;
+        case SEXP_TAG_SYMBOL_REF:
+            return SENTRY_TYPE_SYMBOL;
+        case SEXP_TAG_SHORT_STRING:
+        case SEXP_TAG_LONG_STRING:
+            return SENTRY_TYPE_STRING;
+        case SEXP_TAG_LIST:
+            return SENTRY_TYPE_LIST;
+        default:
+            return SENTRY_TYPE_NIL;
+    }
+}
+
+/*
+ * Append a varint to a StringInfo buffer.
+ */
+static void
+write_varint_to_buf(StringInfo buf, uint64 value)
+{
+    uint8 tmp[10];
+    int len = encode_varint(tmp, value);
+    appendBinaryStringInfo(buf, (char *)tmp, len);
+}
+
+/*
+ * Create an empty transition state in the aggregate context.
+ */
+static SexpAggState *
+agg_state_create(MemoryContext aggcontext)
+{
+    MemoryContext oldcxt = MemoryContextSwitchTo(aggcontext);
+    SexpAggState *state = palloc0(sizeof(SexpAggState));
+
+    sexp_symtab_init(&state->symtab);
+    initStringInfo(&state->elems);
+    state->capacity = 8;
+    state->sentries = palloc(sizeof(SEntry) * state->capacity);
+    state->child_hashes = palloc(sizeof(uint32) * state->capacity);
+    state->nelems = 0;
+
+    MemoryContextSwitchTo(oldcxt);
+    return state;
+}
+
+/*
+ * Make room for one more element in the per-element arrays.
+ */
+static void
+agg_state_ensure_capacity(SexpAggState *state)
+{
+    if (state->nelems >= state->capacity)
+    {
+        int new_capacity = state->capacity * 2;
+
+        state->sentries = repalloc(state->sentries,
+                                   sizeof(SEntry) * new_capacity);
+        state->child_hashes = repalloc(state->child_hashes,
+                                       sizeof(uint32) * new_capacity);
+        state->capacity = new_capacity;
+    }
+}
+
+/*
+ * Append one element (read from *pp in a source value's namespace).
+ * Must be called with CurrentMemoryContext set to the aggregate context.
+ */
+static void
+agg_state_push(SexpAggState *state, uint8 **pp, uint8 *end,
+               char **symbols, int *sym_lengths, int sym_count)
+{
+    int elem_start;
+    uint32 hash;
+
+    agg_state_ensure_capacity(state);
+
+    elem_start = state->elems.len;
+    hash = sexp_reencode_element(&state->elems, pp, end,
+                                 symbols, sym_lengths, sym_count,
+                                 &state->symtab, 0);
+    state->sentries[state->nelems] = SENTRY_MAKE(
+        get_sentry_type_from_tag((uint8)state->elems.data[elem_start]),
+        elem_start);
+    state->child_hashes[state->nelems] = hash;
+    state->nelems++;
+}
+
+/*
+ * sexp_agg_transfn - append one row's value to the transition state.
+ */
+Datum
+sexp_agg_transfn(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcontext;
+    MemoryContext oldcxt;
+    SexpAggState *state;
+    Sexp *elem;
+    SexpReadState elem_state;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "sexp_agg_transfn called in non-aggregate context");
+
+    state = PG_ARGISNULL(0) ? NULL : (SexpAggState *) PG_GETARG_POINTER(0);
+    if (state == NULL)
+        state = agg_state_create(aggcontext);
+
+    if (PG_ARGISNULL(1))
+    {
+        /* NULL becomes nil, matching sexp_build_list */
+        oldcxt = MemoryContextSwitchTo(aggcontext);
+        agg_state_ensure_capacity(state);
+        state->sentries[state->nelems] =
+            SENTRY_MAKE(SENTRY_TYPE_NIL, state->elems.len);
+        state->child_hashes[state->nelems] = 0;
+        appendStringInfoChar(&state->elems, SEXP_TAG_NIL);
+        state->nelems++;
+        MemoryContextSwitchTo(oldcxt);
+        PG_RETURN_POINTER(state);
+    }
+
+    elem = PG_GETARG_SEXP(1);
+    sexp_init_read_state(&elem_state, elem);
+
+    oldcxt = MemoryContextSwitchTo(aggcontext);
+    agg_state_push(state, &elem_state.ptr, elem_state.end,
+                   elem_state.symbols, elem_state.sym_lengths,
+                   elem_state.sym_count);
+    MemoryContextSwitchTo(oldcxt);
+
+    sexp_free_read_state(&elem_state);
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * sexp_agg_combinefn - splice a worker's partial list onto the leader's.
+ *
+ * Elements are re-encoded from the source state's namespace, so only
+ * symbol indices are rewritten; the bytes themselves mostly copy through.
+ */
+Datum
+sexp_agg_combinefn(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcontext;
+    MemoryContext oldcxt;
+    SexpAggState *state1;
+    SexpAggState *state2;
+    uint8 *ptr;
+    uint8 *end;
+    int i;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "sexp_agg_combinefn called in non-aggregate context");
+
+    state1 = PG_ARGISNULL(0) ? NULL : (SexpAggState *) PG_GETARG_POINTER(0);
+    state2 = PG_ARGISNULL(1) ? NULL : (SexpAggState *) PG_GETARG_POINTER(1);
+
+    if (state2 == NULL || state2->nelems == 0)
+    {
+        if (state1 == NULL)
+            PG_RETURN_NULL();
+        PG_RETURN_POINTER(state1);
+    }
+    if (state1 == NULL)
+        state1 = agg_state_create(aggcontext);
+
+    ptr = (uint8 *) state2->elems.data;
+    end = ptr + state2->elems.len;
+
+    oldcxt = MemoryContextSwitchTo(aggcontext);
+    for (i = 0; i < state2->nelems; i++)
+        agg_state_push(state1, &ptr, end,
+                       state2->symtab.symbols, state2->symtab.lengths,
+                       state2->symtab.count);
+    MemoryContextSwitchTo(oldcxt);
+
+    PG_RETURN_POINTER(state1);
+}
+
+/*
+ * sexp_agg_serialfn - transition state to bytea for parallel transfer.
+ *
+ * Layout: [varint sym_count][varint len + bytes per symbol]
+ *         [uint32 nelems][element data]
+ * SEntries and hashes are not shipped; deserialization recomputes them
+ * while re-encoding, which it has to do anyway to rebuild the table.
+ */
+Datum
+sexp_agg_serialfn(PG_FUNCTION_ARGS)
+{
+    SexpAggState *state = (SexpAggState *) PG_GETARG_POINTER(0);
+    StringInfoData buf;
+    bytea *result;
+    uint32 nelems;
+    int i;
+
+    initStringInfo(&buf);
+
+    write_varint_to_buf(&buf, (uint64) state->symtab.count);
+    for (i = 0; i < state->symtab.count; i++)
+    {
+        write_varint_to_buf(&buf, (uint64) state->symtab.lengths[i]);
+        appendBinaryStringInfo(&buf, state->symtab.symbols[i],
+                               state->symtab.lengths[i]);
+    }
+
+    nelems = (uint32) state->nelems;
+    appendBinaryStringInfo(&buf, (char *) &nelems, sizeof(uint32));
+    appendBinaryStringInfo(&buf, state->elems.data, state->elems.len);
+
+    result = (bytea *) palloc(VARHDRSZ + buf.len);
+    SET_VARSIZE(result, VARHDRSZ + buf.len);
+    memcpy(VARDATA(result), buf.data, buf.len);
+    pfree(buf.data);
+
+    PG_RETURN_BYTEA_P(result);
+}
+
+/*
+ * sexp_agg_deserialfn - rebuild a transition state from its bytea image.
+ */
+Datum
+sexp_agg_deserialfn(PG_FUNCTION_ARGS)
+{
+    bytea *serialized = PG_GETARG_BYTEA_PP(0);
+    SexpAggState *state;
+    uint8 *ptr = (uint8 *) VARDATA_ANY(serialized);
+    uint8 *end = ptr + VARSIZE_ANY_EXHDR(serialized);
+    uint64 sym_count;
+    char **symbols;
+    int *sym_lengths;
+    uint32 nelems;
+    uint64 i;
+
+    state = agg_state_create(CurrentMemoryContext);
+
+    /* Decode the serialized symbol table (points into the bytea) */
+    sym_count = decode_varint(&ptr, end);
+    symbols = sym_count > 0 ? palloc(sizeof(char *) * sym_count) : NULL;
+    sym_lengths = sym_count > 0 ? palloc(sizeof(int) * sym_count) : NULL;
+    for (i = 0; i < sym_count; i++)
+    {
+        uint64 slen = decode_varint(&ptr, end);
+
+        if (unlikely(slen > (uint64)(end - ptr)))
+            ereport(ERROR,
+                    (errcode(ERRCODE_DATA_CORRUPTED),
+                     errmsg("corrupted sexp_agg serialization")));
+        sym_lengths[i] = (int) slen;
+        symbols[i] = (char *) ptr;
+        ptr += slen;
+    }
+
+    if (unlikely(ptr + sizeof(uint32) > end))
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("corrupted sexp_agg serialization")));
+    memcpy(&nelems, ptr, sizeof(uint32));
+    ptr += sizeof(uint32);
+
+    /* Re-encode elements into the fresh state, rebuilding SEntries/hashes */
+    for (i = 0; i < nelems; i++)
+        agg_state_push(state, &ptr, end,
+                       symbols, sym_lengths, (int) sym_count);
+
+    if (symbols)
+    {
+        pfree(symbols);
+        pfree(sym_lengths);
+    }
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * sexp_agg_finalfn - wrap the accumulated elements into a list value.
+ *
+ * Emits the same small/large list encoding as the parser, with the large
+ * list hash combined from the cached per-element hashes, then assembles
+ * the value through the shared sexp_build_result tail. The state is left
+ * untouched so re-finalization (e.g. under GROUPING SETS) is safe.
+ */
+Datum
+sexp_agg_finalfn(PG_FUNCTION_ARGS)
+{
+    SexpAggState *state;
+    StringInfoData list_buf;
+    Sexp *result;
+    int i;
+
+    state = PG_ARGISNULL(0) ? NULL : (SexpAggState *) PG_GETARG_POINTER(0);
+    if (state == NULL)
+        PG_RETURN_NULL();
+
+    initStringInfo(&list_buf);
+
+    if (state->nelems == 0)
+        appendStringInfoChar(&list_buf, SEXP_TAG_NIL);
+    else if (state->nelems <= SEXP_SMALL_LIST_MAX)
+    {
+        appendStringInfoChar(&list_buf,
+                             (char)(SEXP_TAG_LIST | (uint8) state->nelems));
+        write_varint_to_buf(&list_buf, (uint64) state->elems.len);
+        appendBinaryStringInfo(&list_buf, state->elems.data, state->elems.len);
+    }
+    else
+    {
+        uint32 cnt32 = (uint32) state->nelems;
+        uint32 list_hash;
+
+        list_hash = sexp_hash_uint32(cnt32);
+        list_hash = hash_combine(list_hash, sexp_hash_uint32(SEXP_TAG_LIST));
+        for (i = 0; i < state->nelems; i++)
+            list_hash = sexp_hash_combine(list_hash, state->child_hashes[i], i);
+
+        appendStringInfoChar(&list_buf, (char) SEXP_TAG_LIST);
+        appendBinaryStringInfo(&list_buf, (char *) &cnt32, sizeof(uint32));
+        appendBinaryStringInfo(&list_buf, (char *) &list_hash, sizeof(uint32));
+        appendBinaryStringInfo(&list_buf, (char *) state->sentries,
+                               state->nelems * sizeof(SEntry));
+        appendBinaryStringInfo(&list_buf, state->elems.data, state->elems.len);
+    }
+
+    result = sexp_build_result(&list_buf, &state->symtab);
+    pfree(list_buf.data);
+
+    PG_RETURN_SEXP(result);
+}
@@ -0,0 +1,463 @@
+/*
+ * sexp_build.c
+ *
+ * Constructors that emit the binary format directly from typed values.
+ *
+ * Ingestion pipelines that already hold ints, floats and text from other
+ * columns previously had to format them into a string and push it through
+ * the text parser - printf plus full tokenization for data that was never
+ * text. The functions here write the binary encoding (varint/zigzag/SEntry)
+ * straight from the Datum values:
+ *
+ *   sexp_build_list(VARIADIC "any")  - list from any mix of supported types
+ *   sexp_symbol(text)                - single symbol
+ *   sexp_string(text)                - single string
+ *   sexp_int(bigint)                 - single integer
+ *   sexp_float(double precision)     - single float
+ *
+ * sexp arguments to sexp_build_list are spliced in as elements via the
+ * shared re-encoder, so nested structures can be composed without ever
+ * rendering text. Output is assembled exactly like the parser's
+ * (version 7 with root hash/Bloom metadata), so constructed values are
+ * indistinguishable from parsed ones.
+ */
+
+#include "pg_sexp.h"
+#include "sexp_debug.h"
+#include "funcapi.h"
+#include "catalog/pg_type.h"
+#include "utils/builtins.h"
+#include <ctype.h>
+#include <string.h>
+
+/*
+ * Map an element's first byte to its SEntry type class.
+ * (Same mapping as the parser's private helper.)
+ */
+static uint32
+get_sentry_type_from_tag(uint8 tag_byte)
+{
+    uint8 tag = tag_byte & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+            return SENTRY_TYPE_NIL;
+        case SEXP_TAG_SMALLINT:
+        case SEXP_TAG_INTEGER:
+            return SENTRY_TYPE_INTEGER;
+        case SEXP_TAG_FLOAT:
+            return SENTRY_TYPE_FLOAT;
+        case SEXP_TAG_SYMBOL_REF:
+            return SENTRY_TYPE_SYMBOL;
+        case SEXP_TAG_SHORT_STRING:
+        case SEXP_TAG_LONG_STRING:
+            return SENTRY_TYPE_STRING;
+        case SEXP_TAG_LIST:
+            return SENTRY_TYPE_LIST;
+        default:
+            return SENTRY_TYPE_NIL;
+    }
+}
+
+/*
+ * Append a varint to a StringInfo buffer.
+ */
+static void
+write_varint_to_buf(StringInfo buf, uint64 value)
+{
+    uint8 tmp[10];
+    int len = encode_varint(tmp, value);
+    appendBinaryStringInfo(buf, (char *)tmp, len);
+}
+
+/*
+ * Emit an integer element, using the compact smallint form when possible.
+ * Matches the parser's encoding; returns the element's structural hash.
+ */
+static uint32
+emit_int(StringInfo out, int64 val)
+{
+    if (val >= SEXP_SMALLINT_MIN && val <= SEXP_SMALLINT_MAX)
+        appendStringInfoChar(out, SEXP_TAG_SMALLINT | (uint8)((int)val + SEXP_SMALLINT_BIAS));
+    else
+    {
+        appendStringInfoChar(out, SEXP_TAG_INTEGER);
+        write_varint_to_buf(out, zigzag_encode(val));
+    }
+    return hash_combine(sexp_hash_uint32(SEXP_TAG_INTEGER),
+                        sexp_hash_int64(val));
+}
+
+/*
+ * Emit a float element; returns its structural hash.
+ */
+static uint32
+emit_float(StringInfo out, float8 val)
+{
+    appendStringInfoChar(out, SEXP_TAG_FLOAT);
+    appendBinaryStringInfo(out, (char *)&val, sizeof(float8));
+    return hash_combine(sexp_hash_uint32(SEXP_TAG_FLOAT),
+                        sexp_hash_float64(val));
+}
+
+/*
+ * Emit a string element, short or long form by length; returns its
+ * structural hash (strings hash under the short tag regardless of form).
+ */
+static uint32
+emit_string(StringInfo out, const char *data, int len)
+{
+    if (len <= SEXP_SHORT_STRING_MAX)
+    {
+        appendStringInfoChar(out, SEXP_TAG_SHORT_STRING | (uint8)len);
+        appendBinaryStringInfo(out, data, len);
+    }
+    else
+    {
+        appendStringInfoChar(out, SEXP_TAG_LONG_STRING);
+        write_varint_to_buf(out, (uint64)len);
+        appendBinaryStringInfo(out, data, len);
+    }
+    return sexp_hash_string_with_tag(SEXP_TAG_SHORT_STRING, data, len);
+}
+
+/*
+ * Emit a symbol element, interning into the build's symbol table.
+ *
+ * The text must round-trip through the text format unchanged, so it has to
+ * be a valid symbol token: non-empty, no tokenizer delimiters (whitespace,
+ * parens, quote, comment start), and not something the tokenizer would
+ * classify as a number.
+ */
+static void
+emit_symbol(StringInfo out, SexpSymbolTable *symtab, const char *sym, int len)
+{
+    bool is_number = true;
+    bool has_dot = false;
+    bool has_digit = false;
+    int sym_idx;
+    int i;
+
+    if (len <= 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("symbol must not be empty")));
+
+    for (i = 0; i < len; i++)
+    {
+        char c = sym[i];
+
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+            c == '(' || c == ')' || c == '"' || c == ';' || c == '\0')
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("invalid character in symbol: \"%.*s\"", len, sym)));
+
+        /* Same number classification as the tokenizer */
+        if (c == '-' || c == '+')
+        {
+            if (i != 0)
+                is_number = false;
+        }
+        else if (c == '.')
+        {
+            if (has_dot)
+                is_number = false;
+            has_dot = true;
+        }
+        else if (isdigit((unsigned char) c))
+            has_digit = true;
+        else
+            is_number = false;
+    }
+
+    if (is_number && has_digit)
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("symbol \"%.*s\" would parse as a number", len, sym)));
+
+    sym_idx = sexp_symtab_intern(symtab, sym, len);
+    appendStringInfoChar(out, SEXP_TAG_SYMBOL_REF);
+    write_varint_to_buf(out, sym_idx);
+}
+
+/*
+ * Assemble the final Sexp from a built root element and its symbol table.
+ * Mirrors the tail of sexp_parse: version byte, v7 root hash/Bloom
+ * metadata, symbol table, element data. Shared with the aggregate in
+ * sexp_agg.c, which accumulates its root list the same way.
+ */
+Sexp *
+sexp_build_result(StringInfo element_buf, SexpSymbolTable *symtab)
+{
+    StringInfoData final_buf;
+    Sexp *result;
+    int total_size;
+    uint32 root_hash;
+    SexpWideBloom root_bloom;
+    int elem_count;
+    int nwords;
+    int i;
+
+    /*
+     * Accumulate the Bloom signature at maximum width while counting
+     * elements, then fold to the width the count calls for; the width
+     * code rides in the version byte like the parser's.
+     */
+    bloom_wide_init(&root_bloom, SEXP_BLOOM_MAX_WORDS);
+    elem_count = sexp_element_bloom_acc((uint8 *)element_buf->data,
+                                        (uint8 *)element_buf->data + element_buf->len,
+                                        symtab->symbols, symtab->lengths,
+                                        symtab->count, &root_bloom);
+    nwords = bloom_words_for_count(elem_count);
+    bloom_wide_fold(&root_bloom, nwords);
+
+    initStringInfo(&final_buf);
+    appendStringInfoChar(&final_buf,
+                         SEXP_FORMAT_VERSION |
+                         (bloom_width_code(nwords) << SEXP_BLOOM_WIDTH_SHIFT));
+
+    root_hash = sexp_element_hash((uint8 *)element_buf->data,
+                                  (uint8 *)element_buf->data + element_buf->len,
+                                  symtab->symbols, symtab->lengths,
+                                  symtab->count);
+    appendBinaryStringInfo(&final_buf, (char *)&root_hash, sizeof(uint32));
+    appendBinaryStringInfo(&final_buf, (char *)root_bloom.words,
+                           nwords * sizeof(uint64));
+
+    write_varint_to_buf(&final_buf, symtab->count);
+    for (i = 0; i < symtab->count; i++)
+    {
+        write_varint_to_buf(&final_buf, symtab->lengths[i]);
+        appendBinaryStringInfo(&final_buf, symtab->symbols[i],
+                               symtab->lengths[i]);
+    }
+
+    appendBinaryStringInfo(&final_buf, element_buf->data, element_buf->len);
+
+    total_size = VARHDRSZ + final_buf.len;
+    result = (Sexp *) palloc(total_size);
+    SET_VARSIZE(result, total_size);
+    memcpy(&result->version, final_buf.data, final_buf.len);
+
+    pfree(final_buf.data);
+    return result;
+}
+
+/*
+ * sexp_build_list(VARIADIC "any") - build a list from typed values.
+ *
+ * Integer and float types are encoded directly; text becomes a string
+ * element; sexp arguments are spliced in as elements with their symbols
+ * re-interned into the list's table; NULL becomes nil.
+ */
+PG_FUNCTION_INFO_V1(sexp_build_list);
+Datum
+sexp_build_list(PG_FUNCTION_ARGS)
+{
+    Datum *args;
+    Oid *types;
+    bool *nulls;
+    int nargs;
+    Oid sexp_oid;
+    StringInfoData element_buf;
+    StringInfoData list_buf;
+    SexpSymbolTable symtab;
+    SEntry *sentries;
+    uint32 *child_hashes;
+    Sexp *result;
+    int i;
+
+    nargs = extract_variadic_args(fcinfo, 0, true, &args, &types, &nulls);
+    if (nargs < 0)
+        PG_RETURN_NULL();
+
+    /* Our own type Oid: this function returns sexp */
+    sexp_oid = get_fn_expr_rettype(fcinfo->flinfo);
+
+    sexp_symtab_init(&symtab);
+    initStringInfo(&element_buf);
+    sentries = palloc(sizeof(SEntry) * Max(nargs, 1));
+    child_hashes = palloc(sizeof(uint32) * Max(nargs, 1));
+
+    for (i = 0; i < nargs; i++)
+    {
+        int elem_start = element_buf.len;
+
+        if (nulls[i])
+        {
+            appendStringInfoChar(&element_buf, SEXP_TAG_NIL);
+            child_hashes[i] = 0;
+        }
+        else if (types[i] == INT2OID)
+            child_hashes[i] = emit_int(&element_buf, (int64) DatumGetInt16(args[i]));
+        else if (types[i] == INT4OID)
+            child_hashes[i] = emit_int(&element_buf, (int64) DatumGetInt32(args[i]));
+        else if (types[i] == INT8OID)
+            child_hashes[i] = emit_int(&element_buf, DatumGetInt64(args[i]));
+        else if (types[i] == FLOAT4OID)
+            child_hashes[i] = emit_float(&element_buf, (float8) DatumGetFloat4(args[i]));
+        else if (types[i] == FLOAT8OID)
+            child_hashes[i] = emit_float(&element_buf, DatumGetFloat8(args[i]));
+        else if (types[i] == TEXTOID || types[i] == VARCHAROID)
+        {
+            text *t = DatumGetTextPP(args[i]);
+
+            child_hashes[i] = emit_string(&element_buf, VARDATA_ANY(t),
+                                          VARSIZE_ANY_EXHDR(t));
+        }
+        else if (types[i] == sexp_oid)
+        {
+            /* Splice in as an element, remapping symbol references */
+            SexpReadState state;
+
+            sexp_init_read_state_packed(&state,
+                                        (struct varlena *) PG_DETOAST_DATUM_PACKED(args[i]));
+            child_hashes[i] = sexp_reencode_element(&element_buf, &state.ptr,
+                                                    state.end, state.symbols,
+                                                    state.sym_lengths,
+                                                    state.sym_count, &symtab, 0);
+            sexp_free_read_state(&state);
+        }
+        else
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("sexp_build_list: unsupported argument type %s",
+                            format_type_be(types[i]))));
+
+        sentries[i] = SENTRY_MAKE(
+            get_sentry_type_from_tag((uint8) element_buf.data[elem_start]),
+            elem_start);
+    }
+
+    /* Wrap elements in a list (nil when empty), mirroring parse_list */
+    initStringInfo(&list_buf);
+    if (nargs == 0)
+        appendStringInfoChar(&list_buf, SEXP_TAG_NIL);
+    else if (nargs <= SEXP_SMALL_LIST_MAX)
+    {
+        appendStringInfoChar(&list_buf, SEXP_TAG_LIST | (uint8)nargs);
+        write_varint_to_buf(&list_buf, (uint64)element_buf.len);
+        appendBinaryStringInfo(&list_buf, element_buf.data, element_buf.len);
+    }
+    else
+    {
+        uint32 cnt32 = (uint32)nargs;
+        uint32 list_hash;
+
+        /* Same list hash formula as the parser */
+        list_hash = sexp_hash_uint32(cnt32);
+        list_hash = hash_combine(list_hash, sexp_hash_uint32(SEXP_TAG_LIST));
+        for (i = 0; i < nargs; i++)
+            list_hash = sexp_hash_combine(list_hash, child_hashes[i], i);
+
+        appendStringInfoChar(&list_buf, SEXP_TAG_LIST);
+        appendBinaryStringInfo(&list_buf, (char *)&cnt32, sizeof(uint32));
+        appendBinaryStringInfo(&list_buf, (char *)&list_hash, sizeof(uint32));
+        appendBinaryStringInfo(&list_buf, (char *)sentries, nargs * sizeof(SEntry));
+        appendBinaryStringInfo(&list_buf, element_buf.data, element_buf.len);
+    }
+
+    result = sexp_build_result(&list_buf, &symtab);
+
+    sexp_symtab_free(&symtab);
+    pfree(element_buf.data);
+    pfree(list_buf.data);
+    pfree(sentries);
+    pfree(child_hashes);
+
+    PG_RETURN_SEXP(result);
+}
+
+/*
+ * sexp_symbol(text) - build a single-symbol sexp.
+ */
+PG_FUNCTION_INFO_V1(sexp_symbol);
+Datum
+sexp_symbol(PG_FUNCTION_ARGS)
+{
+    text *t = PG_GETARG_TEXT_PP(0);
+    StringInfoData element_buf;
+    SexpSymbolTable symtab;
+    Sexp *result;
+
+    sexp_symtab_init(&symtab);
+    initStringInfo(&element_buf);
+    emit_symbol(&element_buf, &symtab, VARDATA_ANY(t), VARSIZE_ANY_EXHDR(t));
+
+    result = sexp_build_result(&element_buf, &symtab);
+    sexp_symtab_free(&symtab);
+    pfree(element_buf.data);
+
+    PG_RETURN_SEXP(result);
+}
+
+/*
+ * sexp_string(text) - build a single-string sexp.
+ */
+PG_FUNCTION_INFO_V1(sexp_string);
+Datum
+sexp_string(PG_FUNCTION_ARGS)
+{
+    text *t = PG_GETARG_TEXT_PP(0);
+    StringInfoData element_buf;
+    SexpSymbolTable symtab;
+    Sexp *result;
+
+    sexp_symtab_init(&symtab);
+    initStringInfo(&element_buf);
+    emit_string(&element_buf, VARDATA_ANY(t), VARSIZE_ANY_EXHDR(t));
+
+    result = sexp_build_result(&element_buf, &symtab);
+    sexp_symtab_free(&symtab);
+    pfree(element_buf.data);
+
+    PG_RETURN_SEXP(result);
+}
+
+/*
+ * sexp_int(bigint) - build a single-integer sexp.
+ */
+PG_FUNCTION_INFO_V1(sexp_int);
+Datum
+sexp_int(PG_FUNCTION_ARGS)
+{
+    int64 val = PG_GETARG_INT64(0);
+    StringInfoData element_buf;
+    SexpSymbolTable symtab;
+    Sexp *result;
+
+    sexp_symtab_init(&symtab);
+    initStringInfo(&element_buf);
+    emit_int(&element_buf, val);
+
+    result = sexp_build_result(&element_buf, &symtab);
+    sexp_symtab_free(&symtab);
+    pfree(element_buf.data);
+
+    PG_RETURN_SEXP(result);
+}
+
+/*
+ * sexp_float(double precision) - build a single-float sexp.
+ */
+PG_FUNCTION_INFO_V1(sexp_float);
+Datum
+sexp_float(PG_FUNCTION_ARGS)
+{
+    float8 val = PG_GETARG_FLOAT8(0);
+    StringInfoData element_buf;
+    SexpSymbolTable symtab;
+    Sexp *result;
+
+    sexp_symtab_init(&symtab);
+    initStringInfo(&element_buf);
+    emit_float(&element_buf, val);
+
+    result = sexp_build_result(&element_buf, &symtab);
+    sexp_symtab_free(&symtab);
+    pfree(element_buf.data);
+
+    PG_RETURN_SEXP(result);
+}
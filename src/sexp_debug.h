@@ -94,7 +94,8 @@
  */
 #define SEXP_CHECK_VERSION(version) \
     do { \
-        if ((version) > SEXP_FORMAT_VERSION) \
+        if (((version) & 0x0F) > SEXP_FORMAT_VERSION || \
+            ((version) & 0xF0 & ~SEXP_KNOWN_FLAGS) != 0) \
             ereport(ERROR, \
                     (errcode(ERRCODE_DATA_CORRUPTED), \
                      errmsg("sexp format version %d not supported (max %d)", \
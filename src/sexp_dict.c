@@ -0,0 +1,305 @@
+/*
+ * sexp_dict.c
+ *
+ * Shared symbol dictionary.
+ *
+ * Schema-heavy workloads store the same few hundred symbols ("event",
+ * "user-id", "timestamp", ...) in every value's inline symbol table, which
+ * measured as a significant fraction of on-disk footprint. The dictionary
+ * replaces those inline strings with small varint IDs referencing the
+ * pg_sexp_dictionary table (created by the extension script and included
+ * in dumps via pg_extension_config_dump).
+ *
+ * Dictionary encoding is opt-in through the pg_sexp.use_symbol_dictionary
+ * GUC and all-or-nothing per value: the parser consults the per-backend
+ * cache and only sets SEXP_FLAG_DICT_SYMTAB when every symbol in the value
+ * resolved to an ID. Values containing unknown symbols keep their inline
+ * table, so enabling the GUC can never make a write fail or depend on the
+ * dictionary being complete. Population is explicit via pg_sexp_dict_add.
+ *
+ * The cache lives in TopMemoryContext and is loaded from the table with
+ * SPI on first use. Readers that hit an unknown ID force one reload before
+ * erroring, so entries added by other backends become visible without
+ * reconnecting. The name->ID direction does not reload on miss - misses
+ * are the normal case for symbols outside the dictionary.
+ */
+
+#include "pg_sexp.h"
+#include "sexp_debug.h"
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include <string.h>
+
+/* GUC: write dictionary-encoded symbol tables when possible */
+bool sexp_dict_enabled = false;
+
+/*
+ * Per-backend dictionary cache.
+ *
+ * Entries are stored in insertion arrays with two open-addressing index
+ * tables over them (same scheme as SexpSymbolTable): one keyed by symbol
+ * hash for the write path, one keyed by ID for the read path. Everything
+ * hangs off a private child of TopMemoryContext so invalidation is a
+ * single context delete.
+ */
+#define DICT_HASH_EMPTY (-1)
+
+typedef struct SexpDictCache
+{
+    bool        loaded;
+    MemoryContext mcxt;
+    int         count;
+    int32      *ids;
+    char      **symbols;
+    int        *lengths;
+    uint32     *hashes;
+    int        *name_table;     /* symbol hash -> entry index */
+    int         name_mask;
+    int        *id_table;       /* id hash -> entry index */
+    int         id_mask;
+} SexpDictCache;
+
+static SexpDictCache dict_cache = {false, NULL, 0, NULL, NULL, NULL, NULL,
+                                   NULL, 0, NULL, 0};
+
+/*
+ * Drop the cache; the next lookup reloads from the table.
+ */
+void
+sexp_dict_invalidate(void)
+{
+    if (dict_cache.mcxt != NULL)
+        MemoryContextDelete(dict_cache.mcxt);
+    memset(&dict_cache, 0, sizeof(dict_cache));
+}
+
+/*
+ * Load the dictionary table into the cache.
+ */
+static void
+dict_cache_load(void)
+{
+    MemoryContext oldcxt;
+    uint64 i;
+    int hash_size;
+
+    sexp_dict_invalidate();
+
+    dict_cache.mcxt = AllocSetContextCreate(TopMemoryContext,
+                                            "sexp dictionary cache",
+                                            ALLOCSET_DEFAULT_SIZES);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed while loading sexp dictionary");
+
+    if (SPI_execute("SELECT id, symbol FROM pg_sexp_dictionary",
+                    true, 0) != SPI_OK_SELECT)
+        elog(ERROR, "could not read pg_sexp_dictionary");
+
+    oldcxt = MemoryContextSwitchTo(dict_cache.mcxt);
+
+    dict_cache.count = (int) SPI_processed;
+    if (dict_cache.count > 0)
+    {
+        dict_cache.ids = palloc(sizeof(int32) * dict_cache.count);
+        dict_cache.symbols = palloc(sizeof(char *) * dict_cache.count);
+        dict_cache.lengths = palloc(sizeof(int) * dict_cache.count);
+        dict_cache.hashes = palloc(sizeof(uint32) * dict_cache.count);
+    }
+
+    for (i = 0; i < SPI_processed; i++)
+    {
+        bool isnull;
+        Datum d;
+        char *sym;
+        int len;
+
+        d = SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc,
+                          1, &isnull);
+        dict_cache.ids[i] = DatumGetInt32(d);
+
+        sym = SPI_getvalue(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 2);
+        len = strlen(sym);
+        dict_cache.symbols[i] = pnstrdup(sym, len);
+        dict_cache.lengths[i] = len;
+        dict_cache.hashes[i] = hash_bytes((const unsigned char *) sym, len);
+    }
+
+    /* Index tables: power of two, at least 4x entries for low load factor */
+    hash_size = 64;
+    while (hash_size < dict_cache.count * 4)
+        hash_size *= 2;
+
+    dict_cache.name_mask = hash_size - 1;
+    dict_cache.id_mask = hash_size - 1;
+    dict_cache.name_table = palloc(sizeof(int) * hash_size);
+    dict_cache.id_table = palloc(sizeof(int) * hash_size);
+    for (i = 0; i < (uint64) hash_size; i++)
+    {
+        dict_cache.name_table[i] = DICT_HASH_EMPTY;
+        dict_cache.id_table[i] = DICT_HASH_EMPTY;
+    }
+
+    for (i = 0; i < (uint64) dict_cache.count; i++)
+    {
+        int slot;
+
+        slot = dict_cache.hashes[i] & dict_cache.name_mask;
+        while (dict_cache.name_table[slot] != DICT_HASH_EMPTY)
+            slot = (slot + 1) & dict_cache.name_mask;
+        dict_cache.name_table[slot] = (int) i;
+
+        slot = sexp_hash_uint32((uint32) dict_cache.ids[i]) & dict_cache.id_mask;
+        while (dict_cache.id_table[slot] != DICT_HASH_EMPTY)
+            slot = (slot + 1) & dict_cache.id_mask;
+        dict_cache.id_table[slot] = (int) i;
+    }
+
+    MemoryContextSwitchTo(oldcxt);
+    SPI_finish();
+
+    dict_cache.loaded = true;
+}
+
+/*
+ * Look up a symbol's dictionary ID. Returns false when the symbol is not
+ * in the dictionary - the caller falls back to an inline symbol table.
+ */
+bool
+sexp_dict_id_for(const char *sym, int len, int32 *id_out)
+{
+    uint32 hash;
+    int slot;
+    int idx;
+
+    if (!dict_cache.loaded)
+        dict_cache_load();
+    if (dict_cache.count == 0)
+        return false;
+
+    hash = hash_bytes((const unsigned char *) sym, len);
+    slot = hash & dict_cache.name_mask;
+    while ((idx = dict_cache.name_table[slot]) != DICT_HASH_EMPTY)
+    {
+        if (dict_cache.hashes[idx] == hash &&
+            dict_cache.lengths[idx] == len &&
+            memcmp(dict_cache.symbols[idx], sym, len) == 0)
+        {
+            *id_out = dict_cache.ids[idx];
+            return true;
+        }
+        slot = (slot + 1) & dict_cache.name_mask;
+    }
+    return false;
+}
+
+/*
+ * Resolve a dictionary ID to its symbol text (cache-owned, long-lived).
+ * An unknown ID forces one reload - the entry may have been added since
+ * this backend's cache was built - and errors if still missing, since a
+ * stored value references it.
+ */
+static int
+dict_find_id(int32 id)
+{
+    int slot;
+    int idx;
+
+    if (dict_cache.count == 0)
+        return -1;
+
+    slot = sexp_hash_uint32((uint32) id) & dict_cache.id_mask;
+    while ((idx = dict_cache.id_table[slot]) != DICT_HASH_EMPTY)
+    {
+        if (dict_cache.ids[idx] == id)
+            return idx;
+        slot = (slot + 1) & dict_cache.id_mask;
+    }
+    return -1;
+}
+
+char *
+sexp_dict_resolve(int32 id, int *len_out, uint32 *hash_out)
+{
+    int idx;
+
+    if (!dict_cache.loaded)
+        dict_cache_load();
+
+    idx = dict_find_id(id);
+    if (idx < 0)
+    {
+        dict_cache_load();
+        idx = dict_find_id(id);
+        if (idx < 0)
+            ereport(ERROR,
+                    (errcode(ERRCODE_DATA_CORRUPTED),
+                     errmsg("sexp symbol dictionary id %d not found", id)));
+    }
+
+    *len_out = dict_cache.lengths[idx];
+    if (hash_out)
+        *hash_out = dict_cache.hashes[idx];
+    return dict_cache.symbols[idx];
+}
+
+/*
+ * pg_sexp_dict_add(text) - add a symbol to the dictionary, returning its
+ * ID (existing ID if already present). Invalidates this backend's cache.
+ */
+PG_FUNCTION_INFO_V1(pg_sexp_dict_add);
+Datum
+pg_sexp_dict_add(PG_FUNCTION_ARGS)
+{
+    text *sym = PG_GETARG_TEXT_PP(0);
+    Oid argtypes[1] = {TEXTOID};
+    Datum values[1];
+    bool isnull;
+    int32 id;
+    int rc;
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed in pg_sexp_dict_add");
+
+    values[0] = PointerGetDatum(sym);
+    rc = SPI_execute_with_args(
+        "INSERT INTO pg_sexp_dictionary (symbol) VALUES ($1)"
+        " ON CONFLICT (symbol) DO UPDATE SET symbol = EXCLUDED.symbol"
+        " RETURNING id",
+        1, argtypes, values, NULL, false, 1);
+    if (rc != SPI_OK_INSERT_RETURNING || SPI_processed != 1)
+        elog(ERROR, "could not insert into pg_sexp_dictionary");
+
+    id = DatumGetInt32(SPI_getbinval(SPI_tuptable->vals[0],
+                                     SPI_tuptable->tupdesc, 1, &isnull));
+    SPI_finish();
+
+    sexp_dict_invalidate();
+
+    PG_RETURN_INT32(id);
+}
+
+/*
+ * Module load: register the GUC.
+ */
+void _PG_init(void);
+
+void
+_PG_init(void)
+{
+    DefineCustomBoolVariable("pg_sexp.use_symbol_dictionary",
+                             "Write sexp values with shared dictionary symbol tables.",
+                             "When on, values whose symbols are all present in "
+                             "pg_sexp_dictionary store dictionary IDs instead of "
+                             "inline symbol strings.",
+                             &sexp_dict_enabled,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL, NULL, NULL);
+
+    MarkGUCPrefixReserved("pg_sexp");
+}
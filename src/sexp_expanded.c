@@ -0,0 +1,530 @@
+/*
+ * sexp_expanded.c
+ *
+ * Expanded (in-memory) representation for sexp values.
+ *
+ * The flat varlena format is compact and fast to scan, but it is immutable:
+ * building a list one element at a time with car/cdr-style functions copies
+ * the whole value on every call, so a PL/pgSQL loop that appends n elements
+ * costs O(n^2). The expanded form keeps the top-level elements in a growable
+ * buffer with a shared interned symbol table, so each append re-encodes only
+ * the new element. It plugs into the standard expanded-object machinery
+ * (ExpandedObjectHeader) the same way expanded arrays do: PL/pgSQL keeps the
+ * expanded form alive across assignments to the same variable, and the value
+ * is flattened back to the version-6 binary format only when it is stored or
+ * passed somewhere that needs a plain varlena.
+ *
+ * Elements are re-encoded on the way in because symbol indices are relative
+ * to each value's own symbol table: a SYMBOL_REF from the source value must
+ * be remapped into the expanded value's table. The re-encoder also returns
+ * the structural hash of each element (same formula as the parser), so
+ * flattening a large list can store a correct hash without a second pass.
+ */
+
+#include "pg_sexp.h"
+#include "sexp_debug.h"
+#include "utils/expandeddatum.h"
+#include "utils/memutils.h"
+#include <string.h>
+
+/* Identifies an ExpandedSexp among expanded-object headers */
+#define EXPANDED_SEXP_MAGIC 0x53455850  /* "SEXP" */
+
+/*
+ * Expanded sexp: a mutable top-level list.
+ *
+ * The root is always a list (possibly empty). Top-level elements live
+ * concatenated in 'elems', with a per-element SEntry (type + offset) and
+ * structural hash so flattening can emit either list format directly.
+ * Everything hangs off the object's private memory context (hdr.eoh_context).
+ */
+typedef struct ExpandedSexp
+{
+    ExpandedObjectHeader hdr;       /* standard expanded-object header */
+    int32           es_magic;       /* EXPANDED_SEXP_MAGIC */
+    SexpSymbolTable symtab;         /* interned symbols shared by all elements */
+    StringInfoData  elems;          /* concatenated re-encoded element data */
+    SEntry         *sentries;       /* type + offset of each top-level element */
+    uint32         *child_hashes;   /* structural hash of each element */
+    int             nelems;         /* number of top-level elements */
+    int             capacity;       /* allocated entries in the arrays above */
+} ExpandedSexp;
+
+static Size expanded_sexp_get_flat_size(ExpandedObjectHeader *eohptr);
+static void expanded_sexp_flatten_into(ExpandedObjectHeader *eohptr,
+                                       void *result, Size allocated_size);
+
+static const ExpandedObjectMethods expanded_sexp_methods =
+{
+    expanded_sexp_get_flat_size,
+    expanded_sexp_flatten_into
+};
+
+/*
+ * Map an element's first byte to its SEntry type class.
+ * (Same mapping as the parser's private helper.)
+ */
+static uint32
+get_sentry_type_from_tag(uint8 tag_byte)
+{
+    uint8 tag = tag_byte & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+            return SENTRY_TYPE_NIL;
+        case SEXP_TAG_SMALLINT:
+        case SEXP_TAG_INTEGER:
+            return SENTRY_TYPE_INTEGER;
+        case SEXP_TAG_FLOAT:
+            return SENTRY_TYPE_FLOAT;
+        case SEXP_TAG_SYMBOL_REF:
+            return SENTRY_TYPE_SYMBOL;
+        case SEXP_TAG_SHORT_STRING:
+        case SEXP_TAG_LONG_STRING:
+            return SENTRY_TYPE_STRING;
+        case SEXP_TAG_LIST:
+            return SENTRY_TYPE_LIST;
+        default:
+            return SENTRY_TYPE_NIL;
+    }
+}
+
+/*
+ * Append a varint to a StringInfo buffer.
+ */
+static void
+write_varint_to_buf(StringInfo buf, uint64 value)
+{
+    uint8 tmp[10];
+    int len = encode_varint(tmp, value);
+    appendBinaryStringInfo(buf, (char *)tmp, len);
+}
+
+/* Stack buffer size for re-encoded list children - matches the parser */
+#define REENCODE_LIST_STACK_SIZE 16
+
+/*
+ * sexp_reencode_element - copy one element into a new symbol-table namespace.
+ *
+ * Reads the element at *pp (bounded by end, with the source value's decoded
+ * symbol table) and appends an equivalent encoding to 'out', interning every
+ * symbol it references into 'symtab' and rewriting SYMBOL_REF indices to
+ * match. Self-contained atoms are copied verbatim; lists are rebuilt because
+ * remapped symbol indices can change child sizes and thus SEntry offsets.
+ *
+ * Advances *pp past the element and returns its structural hash (computed
+ * with the same formula the parser uses, so rebuilt large lists store a
+ * hash consistent with parsed ones). Shared with other builders that merge
+ * values into a common symbol table.
+ */
+uint32
+sexp_reencode_element(StringInfo out, uint8 **pp, uint8 *end,
+                      char **symbols, int *sym_lengths, int sym_count,
+                      SexpSymbolTable *symtab, int depth)
+{
+    uint8 *p = *pp;
+    uint8 byte;
+    uint8 tag;
+
+    SEXP_CHECK_DEPTH(depth);
+
+    if (unlikely(p >= end))
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("corrupted sexp binary data: truncated element")));
+
+    byte = *p;
+    tag = byte & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+            appendStringInfoChar(out, (char)byte);
+            *pp = p + 1;
+            return 0;  /* NIL has hash 0 */
+
+        case SEXP_TAG_SMALLINT:
+        case SEXP_TAG_INTEGER:
+        case SEXP_TAG_FLOAT:
+        case SEXP_TAG_SHORT_STRING:
+        case SEXP_TAG_LONG_STRING:
+        {
+            /* Self-contained: copy bytes verbatim, hash from source bytes */
+            uint8 *next = sexp_skip_element(p, end);
+            uint32 hash = sexp_element_hash(p, next, symbols, sym_lengths,
+                                            sym_count);
+
+            appendBinaryStringInfo(out, (char *)p, next - p);
+            *pp = next;
+            return hash;
+        }
+
+        case SEXP_TAG_SYMBOL_REF:
+        {
+            uint64 idx;
+            int new_idx;
+
+            p++;
+            idx = decode_varint(&p, end);
+            if (unlikely(idx >= (uint64)sym_count))
+                ereport(ERROR,
+                        (errcode(ERRCODE_DATA_CORRUPTED),
+                         errmsg("corrupted sexp binary data: symbol index out of range")));
+
+            new_idx = sexp_symtab_intern(symtab, symbols[idx],
+                                         sym_lengths[idx]);
+            appendStringInfoChar(out, (char)SEXP_TAG_SYMBOL_REF);
+            write_varint_to_buf(out, (uint64)new_idx);
+            *pp = p;
+
+            /* Symbols hash by text, not index - stable across remapping */
+            return sexp_hash_string_with_tag(SEXP_TAG_SYMBOL_REF,
+                                             symbols[idx], sym_lengths[idx]);
+        }
+
+        case SEXP_TAG_LIST:
+        default:
+        {
+            uint64 count = byte & SEXP_DATA_MASK;
+            StringInfoData elements;
+            SEntry stack_sentries[REENCODE_LIST_STACK_SIZE];
+            uint32 stack_child_hashes[REENCODE_LIST_STACK_SIZE];
+            SEntry *sentries = stack_sentries;
+            uint32 *child_hashes = stack_child_hashes;
+            int child_capacity = REENCODE_LIST_STACK_SIZE;
+            bool use_stack = true;
+            uint32 list_hash;
+            uint64 i;
+
+            p++;
+            if (unlikely(count == 0))
+            {
+                /* Large list: count + stored hash + SEntry table */
+                uint32 cnt32 = SEXP_LOAD_UINT32_UNALIGNED(p);
+                p += sizeof(uint32);
+                count = cnt32;
+                p += sizeof(uint32);            /* stored hash */
+                p += count * sizeof(SEntry);    /* SEntry table */
+            }
+            else
+            {
+                /* Small list: skip the payload-size prefix, rebuilt below */
+                (void)decode_varint(&p, end);
+            }
+
+            /* Re-encode children into a temporary buffer */
+            initStringInfo(&elements);
+            for (i = 0; i < count; i++)
+            {
+                int elem_start;
+                uint32 child_hash;
+
+                if ((int)i >= child_capacity)
+                {
+                    int new_capacity = child_capacity * 2;
+
+                    if (use_stack)
+                    {
+                        SEntry *new_sentries = palloc(sizeof(SEntry) * new_capacity);
+                        uint32 *new_hashes = palloc(sizeof(uint32) * new_capacity);
+
+                        memcpy(new_sentries, sentries, sizeof(SEntry) * i);
+                        memcpy(new_hashes, child_hashes, sizeof(uint32) * i);
+                        sentries = new_sentries;
+                        child_hashes = new_hashes;
+                        use_stack = false;
+                    }
+                    else
+                    {
+                        sentries = repalloc(sentries, sizeof(SEntry) * new_capacity);
+                        child_hashes = repalloc(child_hashes, sizeof(uint32) * new_capacity);
+                    }
+                    child_capacity = new_capacity;
+                }
+
+                elem_start = elements.len;
+                child_hash = sexp_reencode_element(&elements, &p, end,
+                                                   symbols, sym_lengths,
+                                                   sym_count, symtab,
+                                                   depth + 1);
+                child_hashes[i] = child_hash;
+                sentries[i] = SENTRY_MAKE(
+                    get_sentry_type_from_tag((uint8)elements.data[elem_start]),
+                    elem_start);
+            }
+
+            /* Same list hash formula as the parser */
+            list_hash = sexp_hash_uint32((uint32)count);
+            list_hash = hash_combine(list_hash, sexp_hash_uint32(SEXP_TAG_LIST));
+            for (i = 0; i < count; i++)
+                list_hash = sexp_hash_combine(list_hash, child_hashes[i], i);
+
+            if (count <= SEXP_SMALL_LIST_MAX)
+            {
+                appendStringInfoChar(out, (char)(SEXP_TAG_LIST | (uint8)count));
+                write_varint_to_buf(out, (uint64)elements.len);
+                appendBinaryStringInfo(out, elements.data, elements.len);
+            }
+            else
+            {
+                uint32 cnt32 = (uint32)count;
+
+                appendStringInfoChar(out, (char)SEXP_TAG_LIST);
+                appendBinaryStringInfo(out, (char *)&cnt32, sizeof(uint32));
+                appendBinaryStringInfo(out, (char *)&list_hash, sizeof(uint32));
+                appendBinaryStringInfo(out, (char *)sentries, count * sizeof(SEntry));
+                appendBinaryStringInfo(out, elements.data, elements.len);
+            }
+
+            pfree(elements.data);
+            if (!use_stack)
+            {
+                pfree(sentries);
+                pfree(child_hashes);
+            }
+            *pp = p;
+            return list_hash;
+        }
+    }
+}
+
+/*
+ * Append one element (read from *pp in a source value's namespace) to the
+ * expanded list. Must be called with CurrentMemoryContext set to the
+ * expanded object's private context so all growth lands there.
+ */
+static void
+expanded_sexp_push(ExpandedSexp *es, uint8 **pp, uint8 *end,
+                   char **symbols, int *sym_lengths, int sym_count)
+{
+    int elem_start;
+    uint32 hash;
+
+    if (es->nelems >= es->capacity)
+    {
+        int new_capacity = es->capacity * 2;
+
+        es->sentries = repalloc(es->sentries, sizeof(SEntry) * new_capacity);
+        es->child_hashes = repalloc(es->child_hashes, sizeof(uint32) * new_capacity);
+        es->capacity = new_capacity;
+    }
+
+    elem_start = es->elems.len;
+    hash = sexp_reencode_element(&es->elems, pp, end,
+                                 symbols, sym_lengths, sym_count,
+                                 &es->symtab, 0);
+    es->sentries[es->nelems] = SENTRY_MAKE(
+        get_sentry_type_from_tag((uint8)es->elems.data[elem_start]),
+        elem_start);
+    es->child_hashes[es->nelems] = hash;
+    es->nelems++;
+}
+
+/*
+ * Expand a flat sexp into the mutable representation.
+ *
+ * The root must be a list (or nil, which expands to an empty list); anything
+ * else cannot grow by appending. The expanded object gets its own memory
+ * context under parentcontext, so discarding it is a single context delete.
+ */
+static ExpandedSexp *
+expand_sexp(Sexp *sexp, MemoryContext parentcontext)
+{
+    ExpandedSexp *es;
+    MemoryContext objcxt;
+    MemoryContext oldcxt;
+    SexpReadState state;
+    uint8 first_byte;
+    uint8 tag;
+
+    objcxt = AllocSetContextCreate(parentcontext,
+                                   "expanded sexp",
+                                   ALLOCSET_DEFAULT_SIZES);
+    oldcxt = MemoryContextSwitchTo(objcxt);
+
+    es = (ExpandedSexp *) palloc0(sizeof(ExpandedSexp));
+    EOH_init_header(&es->hdr, &expanded_sexp_methods, objcxt);
+    es->es_magic = EXPANDED_SEXP_MAGIC;
+    sexp_symtab_init(&es->symtab);
+    initStringInfo(&es->elems);
+    es->capacity = 8;
+    es->sentries = palloc(sizeof(SEntry) * es->capacity);
+    es->child_hashes = palloc(sizeof(uint32) * es->capacity);
+    es->nelems = 0;
+
+    sexp_init_read_state(&state, sexp);
+
+    first_byte = (state.ptr < state.end) ? *state.ptr : SEXP_TAG_NIL;
+    tag = first_byte & SEXP_TAG_MASK;
+
+    if (tag == SEXP_TAG_LIST)
+    {
+        uint64 count = first_byte & SEXP_DATA_MASK;
+        uint64 i;
+
+        state.ptr++;
+        if (unlikely(count == 0))
+        {
+            /* Large list: count + stored hash + SEntry table */
+            uint32 cnt32 = SEXP_LOAD_UINT32_UNALIGNED(state.ptr);
+            state.ptr += sizeof(uint32);
+            count = cnt32;
+            state.ptr += sizeof(uint32);
+            state.ptr += count * sizeof(SEntry);
+        }
+        else
+            (void)decode_varint(&state.ptr, state.end);
+
+        for (i = 0; i < count; i++)
+            expanded_sexp_push(es, &state.ptr, state.end,
+                               state.symbols, state.sym_lengths,
+                               state.sym_count);
+    }
+    else if (tag != SEXP_TAG_NIL)
+        ereport(ERROR,
+                (errcode(ERRCODE_DATATYPE_MISMATCH),
+                 errmsg("cannot append to a non-list sexp")));
+
+    sexp_free_read_state(&state);
+    MemoryContextSwitchTo(oldcxt);
+
+    return es;
+}
+
+/*
+ * Flat size of the expanded value: varlena header + version byte + symbol
+ * table + root list encoding. Flattened values are plain version 6; root
+ * metadata is only produced by the parser.
+ */
+static Size
+expanded_sexp_get_flat_size(ExpandedObjectHeader *eohptr)
+{
+    ExpandedSexp *es = (ExpandedSexp *) eohptr;
+    Size size;
+    int i;
+
+    Assert(es->es_magic == EXPANDED_SEXP_MAGIC);
+
+    size = VARHDRSZ + 1;  /* varlena header + version byte */
+
+    size += varint_size((uint64)es->symtab.count);
+    for (i = 0; i < es->symtab.count; i++)
+        size += varint_size((uint64)es->symtab.lengths[i]) + es->symtab.lengths[i];
+
+    if (es->nelems == 0)
+        size += 1;  /* NIL tag */
+    else if (es->nelems <= SEXP_SMALL_LIST_MAX)
+        size += 1 + varint_size((uint64)es->elems.len) + es->elems.len;
+    else
+        size += 1 + 2 * sizeof(uint32)
+              + es->nelems * sizeof(SEntry) + es->elems.len;
+
+    return size;
+}
+
+/*
+ * Flatten the expanded value into caller-provided space. The element data
+ * and SEntry table are already in flat form, so this is a header write plus
+ * bulk copies; the large-list hash is combined from the cached child hashes.
+ */
+static void
+expanded_sexp_flatten_into(ExpandedObjectHeader *eohptr,
+                           void *result, Size allocated_size)
+{
+    ExpandedSexp *es = (ExpandedSexp *) eohptr;
+    uint8 *dst = (uint8 *)result + VARHDRSZ;
+    int i;
+
+    Assert(es->es_magic == EXPANDED_SEXP_MAGIC);
+    Assert(allocated_size == expanded_sexp_get_flat_size(eohptr));
+
+    SET_VARSIZE(result, allocated_size);
+    *dst++ = SEXP_FORMAT_VERSION_V6;
+
+    /* Symbol table */
+    dst += encode_varint(dst, (uint64)es->symtab.count);
+    for (i = 0; i < es->symtab.count; i++)
+    {
+        dst += encode_varint(dst, (uint64)es->symtab.lengths[i]);
+        memcpy(dst, es->symtab.symbols[i], es->symtab.lengths[i]);
+        dst += es->symtab.lengths[i];
+    }
+
+    /* Root list */
+    if (es->nelems == 0)
+        *dst++ = SEXP_TAG_NIL;
+    else if (es->nelems <= SEXP_SMALL_LIST_MAX)
+    {
+        *dst++ = SEXP_TAG_LIST | (uint8)es->nelems;
+        dst += encode_varint(dst, (uint64)es->elems.len);
+        memcpy(dst, es->elems.data, es->elems.len);
+        dst += es->elems.len;
+    }
+    else
+    {
+        uint32 cnt32 = (uint32)es->nelems;
+        uint32 list_hash;
+
+        list_hash = sexp_hash_uint32(cnt32);
+        list_hash = hash_combine(list_hash, sexp_hash_uint32(SEXP_TAG_LIST));
+        for (i = 0; i < es->nelems; i++)
+            list_hash = sexp_hash_combine(list_hash, es->child_hashes[i], i);
+
+        *dst++ = SEXP_TAG_LIST;
+        memcpy(dst, &cnt32, sizeof(uint32));
+        dst += sizeof(uint32);
+        memcpy(dst, &list_hash, sizeof(uint32));
+        dst += sizeof(uint32);
+        memcpy(dst, es->sentries, es->nelems * sizeof(SEntry));
+        dst += es->nelems * sizeof(SEntry);
+        memcpy(dst, es->elems.data, es->elems.len);
+        dst += es->elems.len;
+    }
+
+    Assert(dst == (uint8 *)result + allocated_size);
+    (void) dst;
+}
+
+/*
+ * sexp_append(list, element) - append an element to a list.
+ *
+ * Returns a read-write expanded datum. When the first argument is already
+ * our expanded form (the common case inside a PL/pgSQL loop assigning back
+ * to the same variable), we append in place; otherwise we expand the flat
+ * value first. Either way the per-call cost is the size of the new element,
+ * not the size of the accumulated list.
+ */
+PG_FUNCTION_INFO_V1(sexp_append_func);
+Datum
+sexp_append_func(PG_FUNCTION_ARGS)
+{
+    Datum d0 = PG_GETARG_DATUM(0);
+    ExpandedSexp *es = NULL;
+    Sexp *elem;
+    SexpReadState elem_state;
+    MemoryContext oldcxt;
+
+    if (VARATT_IS_EXTERNAL_EXPANDED_RW(DatumGetPointer(d0)))
+    {
+        ExpandedSexp *candidate = (ExpandedSexp *) DatumGetEOHP(d0);
+
+        if (candidate->es_magic == EXPANDED_SEXP_MAGIC)
+            es = candidate;
+    }
+    if (es == NULL)
+        es = expand_sexp(PG_GETARG_SEXP(0), CurrentMemoryContext);
+
+    elem = PG_GETARG_SEXP(1);
+    sexp_init_read_state(&elem_state, elem);
+
+    oldcxt = MemoryContextSwitchTo(es->hdr.eoh_context);
+    expanded_sexp_push(es, &elem_state.ptr, elem_state.end,
+                       elem_state.symbols, elem_state.sym_lengths,
+                       elem_state.sym_count);
+    MemoryContextSwitchTo(oldcxt);
+
+    sexp_free_read_state(&elem_state);
+
+    PG_RETURN_DATUM(EOHPGetRWDatum(&es->hdr));
+}
@@ -31,14 +31,14 @@
 
 #include "pg_sexp.h"
 #include "sexp_debug.h"
+#include "sexp_stats.h"
+#include "utils/memutils.h"
 #include "access/gin.h"
 #include "access/stratnum.h"
 #include "utils/builtins.h"
 
 /* Strategy numbers for GIN operators */
-#define SEXP_GIN_CONTAINS_STRATEGY     7   /* @> structural containment */
-#define SEXP_GIN_CONTAINED_STRATEGY    8   /* <@ contained by */
-#define SEXP_GIN_CONTAINS_KEY_STRATEGY 9   /* @>> key-based containment */
+/* Strategy numbers are in pg_sexp.h (shared with sexp_selfuncs.c) */
 
 /* Key type markers (mixed into hash to distinguish key types) */
 #define KEY_TYPE_ATOM       0x01000000
@@ -84,25 +84,41 @@
  */
 #define KEY_HASHSET_SIZE 4096  /* Must be power of 2 and > 2*MAX_GIN_KEYS */
 #define KEY_HASHSET_MASK (KEY_HASHSET_SIZE - 1)
-#define KEY_HASHSET_EMPTY 0x7F7F7F7F  /* Sentinel: all bytes 0x7F for fast memset */
 
 typedef struct KeyHashSet
 {
     int32   slots[KEY_HASHSET_SIZE];
+    uint32  gens[KEY_HASHSET_SIZE];  /* Slot is live iff gens[i] == gen */
+    uint32  gen;
     int     count;
 } KeyHashSet;
 
 /*
- * Initialize hash set using memset for speed.
- * OPTIMIZATION: memset is much faster than a loop (uses SIMD on modern CPUs).
- * The sentinel value 0x7F7F7F7F is chosen because memset works byte-by-byte,
- * so memset(ptr, 0x7F, size) fills each byte with 0x7F, resulting in
- * the 32-bit value 0x7F7F7F7F in each slot.
+ * One-time initialization. Afterwards the set is cleared between uses
+ * with key_hashset_clear(), which just bumps the generation counter.
  */
 static inline void
 key_hashset_init(KeyHashSet *hs)
 {
-    memset(hs->slots, 0x7F, sizeof(hs->slots));
+    memset(hs->gens, 0, sizeof(hs->gens));
+    hs->gen = 1;
+    hs->count = 0;
+}
+
+/*
+ * Clear the set in O(1) by advancing the generation counter.
+ * OPTIMIZATION: avoids the 16KB memset per indexed value that dominated
+ * allocator overhead in index builds. On the (rare) generation wraparound
+ * we fall back to a full reinit so stale stamps can never read as live.
+ */
+static inline void
+key_hashset_clear(KeyHashSet *hs)
+{
+    if (++hs->gen == 0)
+    {
+        key_hashset_init(hs);
+        return;
+    }
     hs->count = 0;
 }
 
@@ -115,13 +131,14 @@ key_hashset_insert(KeyHashSet *hs, int32 key)
 {
     uint32 idx = ((uint32)key) & KEY_HASHSET_MASK;
     int probes = 0;
-    
+
     while (probes < KEY_HASHSET_SIZE)
     {
-        if (hs->slots[idx] == KEY_HASHSET_EMPTY)
+        if (hs->gens[idx] != hs->gen)
         {
             /* Empty slot - insert here */
             hs->slots[idx] = key;
+            hs->gens[idx] = hs->gen;
             hs->count++;
             return true;
         }
@@ -134,11 +151,78 @@ key_hashset_insert(KeyHashSet *hs, int32 key)
         idx = (idx + 1) & KEY_HASHSET_MASK;
         probes++;
     }
-    
+
     /* Table full - shouldn't happen with proper sizing */
     return false;
 }
 
+/*
+ * Per-backend scratch for key extraction.
+ *
+ * Index builds call sexp_gin_extract_value once per row; allocating a
+ * fresh hash set and growing the key array from scratch every time made
+ * the allocator the bottleneck. Instead the scratch lives for the life
+ * of the backend in TopMemoryContext: the hash set is cleared between
+ * values via the generation counter, and the key array and decoded
+ * symbol-table arrays keep whatever capacity past values have grown
+ * them to. Each parallel CREATE INDEX worker is its own backend with
+ * its own scratch, so workers never serialize on per-tuple setup.
+ */
+typedef struct GinExtractScratch
+{
+    KeyHashSet  seen;
+    int32      *keys;
+    int         capacity;
+    char      **symbols;        /* decoded symbol-table scratch */
+    int        *sym_lengths;
+    int         sym_capacity;
+} GinExtractScratch;
+
+static GinExtractScratch *gin_scratch = NULL;
+
+static GinExtractScratch *
+get_gin_scratch(void)
+{
+    if (gin_scratch == NULL)
+    {
+        gin_scratch = MemoryContextAllocZero(TopMemoryContext,
+                                             sizeof(GinExtractScratch));
+        key_hashset_init(&gin_scratch->seen);
+        gin_scratch->keys = MemoryContextAlloc(TopMemoryContext,
+                                               sizeof(int32) * 64);
+        gin_scratch->capacity = 64;
+        gin_scratch->symbols = MemoryContextAlloc(TopMemoryContext,
+                                                  sizeof(char *) * SEXP_SMALL_SYMTAB_SIZE);
+        gin_scratch->sym_lengths = MemoryContextAlloc(TopMemoryContext,
+                                                      sizeof(int) * SEXP_SMALL_SYMTAB_SIZE);
+        gin_scratch->sym_capacity = SEXP_SMALL_SYMTAB_SIZE;
+    }
+
+    key_hashset_clear(&gin_scratch->seen);
+    return gin_scratch;
+}
+
+/*
+ * Make sure the scratch symbol arrays can hold sym_count entries.
+ * Grows geometrically and never shrinks, so a page of similarly-shaped
+ * tuples pays for the allocation once.
+ */
+static void
+gin_scratch_ensure_symbols(GinExtractScratch *scratch, int sym_count)
+{
+    int newcap = scratch->sym_capacity;
+
+    if (sym_count <= newcap)
+        return;
+
+    while (newcap < sym_count)
+        newcap *= 2;
+
+    scratch->symbols = repalloc(scratch->symbols, sizeof(char *) * newcap);
+    scratch->sym_lengths = repalloc(scratch->sym_lengths, sizeof(int) * newcap);
+    scratch->sym_capacity = newcap;
+}
+
 /* Forward declarations */
 static void extract_keys_recursive(uint8 *ptr, uint8 *end, 
                                    char **symbols, int *sym_lengths, int sym_count,
@@ -550,55 +634,60 @@ sexp_gin_extract_value(PG_FUNCTION_ARGS)
     int         sym_count;
     char      **symbols;
     int        *sym_lengths;
-    char       *stack_symbols[SEXP_SMALL_SYMTAB_SIZE];
-    int         stack_lengths[SEXP_SMALL_SYMTAB_SIZE];
-    bool        use_stack;
     int         i;
-    KeyHashSet  seen;
-    
-    /* Initialize */
-    keys = palloc(sizeof(int32) * 64);
-    capacity = 64;
-    key_hashset_init(&seen);
-    
+    GinExtractScratch *scratch;
+
+    /* Reuse the per-backend scratch (cleared hash set, warm arrays) */
+    scratch = get_gin_scratch();
+    keys = scratch->keys;
+    capacity = scratch->capacity;
+
     data = SEXP_DATA_PTR(sexp);
     end = data + SEXP_DATA_SIZE(sexp);
     ptr = data;
-    
-    /* Read symbol table */
+
+    /* Skip v7 root metadata - keys come from the elements themselves */
+    if (SEXP_VERSION_HAS_ROOT_META(sexp->version))
+        ptr += SEXP_ROOT_META_SIZE_V(sexp->version);
+
+    /* Read symbol table into the warm scratch arrays */
     sym_count = (int)decode_varint(&ptr, end);
-    use_stack = (sym_count <= SEXP_SMALL_SYMTAB_SIZE);
-    
-    if (use_stack)
+    gin_scratch_ensure_symbols(scratch, sym_count);
+    symbols = scratch->symbols;
+    sym_lengths = scratch->sym_lengths;
+
+    if (SEXP_VERSION_HAS_DICT(sexp->version))
     {
-        symbols = stack_symbols;
-        sym_lengths = stack_lengths;
+        /* Dictionary symbol table: resolve varint IDs via the backend cache */
+        for (i = 0; i < sym_count; i++)
+        {
+            int32 id = (int32)(uint32) decode_varint(&ptr, end);
+            symbols[i] = sexp_dict_resolve(id, &sym_lengths[i], NULL);
+        }
     }
     else
     {
-        symbols = palloc(sizeof(char *) * sym_count);
-        sym_lengths = palloc(sizeof(int) * sym_count);
-    }
-    
-    for (i = 0; i < sym_count; i++)
-    {
-        int len = (int)decode_varint(&ptr, end);
-        symbols[i] = (char *)ptr;
-        sym_lengths[i] = len;
-        ptr += len;
+        for (i = 0; i < sym_count; i++)
+        {
+            int len = (int)decode_varint(&ptr, end);
+            symbols[i] = (char *)ptr;
+            sym_lengths[i] = len;
+            ptr += len;
+        }
     }
-    
+
     /* Extract keys */
     extract_keys_recursive(ptr, end, symbols, sym_lengths, sym_count,
-                          &keys, &key_count, &capacity, &seen);
-    
-    /* Clean up symbol table if heap-allocated */
-    if (!use_stack)
-    {
-        pfree(symbols);
-        pfree(sym_lengths);
-    }
-    
+                          &keys, &key_count, &capacity, &scratch->seen);
+
+    /* add_key may have grown the array - remember it for the next value */
+    scratch->keys = keys;
+    scratch->capacity = capacity;
+
+    SEXP_STAT_INC(gin_values_indexed);
+    SEXP_STAT_ADD(gin_keys_emitted, key_count);
+
+
     /* Convert to Datum array */
     if (key_count == 0)
     {
@@ -616,8 +705,6 @@ sexp_gin_extract_value(PG_FUNCTION_ARGS)
         }
     }
     
-    pfree(keys);
-    
     PG_RETURN_POINTER(keys_out);
 }
 
@@ -825,6 +912,161 @@ extract_query_keys_recursive(uint8 *ptr, uint8 *end,
     }
 }
 
+/*
+ * Extract keys from a pattern for @~ queries.
+ *
+ * A pattern mixes literals with wildcards (_, _*) and captures (?name,
+ * ??rest).  Only the literal atoms are usable as index keys: every literal
+ * atom in the pattern must appear verbatim in any matching value, and value
+ * extraction indexes every atom, so the resulting key set never produces a
+ * false negative.  Structural keys (LIST_HEAD, PAIR) are deliberately NOT
+ * emitted here - a wildcard inside a list changes the element count or pair
+ * shape the stored value would have been keyed under, so those keys could
+ * exclude legitimate matches.
+ */
+static void
+extract_pattern_keys_recursive(uint8 *ptr, uint8 *end,
+                               char **symbols, int *sym_lengths, int sym_count,
+                               int32 **keys, int *nkeys, int *capacity,
+                               KeyHashSet *seen)
+{
+    uint8 tag;
+    uint32 hash;
+
+    if (ptr >= end || *nkeys >= MAX_GIN_KEYS)
+        return;
+
+    tag = *ptr & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+            hash = sexp_hash_uint32(0);
+            add_key(keys, nkeys, capacity, make_atom_key(KEY_TYPE_ATOM, hash), seen);
+            break;
+
+        case SEXP_TAG_SMALLINT:
+        {
+            int8 val = (*ptr & SEXP_DATA_MASK) - SEXP_SMALLINT_BIAS;
+            hash = sexp_hash_int64((int64)val);
+            add_key(keys, nkeys, capacity, make_atom_key(KEY_TYPE_INTEGER, hash), seen);
+            break;
+        }
+
+        case SEXP_TAG_INTEGER:
+        {
+            uint8 *p = ptr + 1;
+            uint64 uval = decode_varint(&p, end);
+            int64 val = zigzag_decode(uval);
+            hash = sexp_hash_int64(val);
+            add_key(keys, nkeys, capacity, make_atom_key(KEY_TYPE_INTEGER, hash), seen);
+            break;
+        }
+
+        case SEXP_TAG_FLOAT:
+        {
+            if (ptr + 9 <= end)
+            {
+                double dval;
+                memcpy(&dval, ptr + 1, sizeof(double));
+                hash = sexp_hash_float64(dval);
+                add_key(keys, nkeys, capacity, make_atom_key(KEY_TYPE_FLOAT, hash), seen);
+            }
+            break;
+        }
+
+        case SEXP_TAG_SYMBOL_REF:
+        {
+            uint8 *p = ptr + 1;
+            uint64 idx = decode_varint(&p, end);
+            if (idx < (uint64)sym_count)
+            {
+                /* Wildcards and captures match anything - no key */
+                if (sexp_symbol_is_pattern(symbols[idx], sym_lengths[idx]))
+                    break;
+                hash = sexp_hash_bytes(symbols[idx], sym_lengths[idx]);
+                add_key(keys, nkeys, capacity, make_atom_key(KEY_TYPE_SYMBOL, hash), seen);
+            }
+            break;
+        }
+
+        case SEXP_TAG_SHORT_STRING:
+        {
+            int len = *ptr & SEXP_DATA_MASK;
+            if (ptr + 1 + len <= end)
+            {
+                hash = sexp_hash_bytes(ptr + 1, len);
+                add_key(keys, nkeys, capacity, make_atom_key(KEY_TYPE_STRING, hash), seen);
+            }
+            break;
+        }
+
+        case SEXP_TAG_LONG_STRING:
+        {
+            uint8 *p = ptr + 1;
+            uint64 len = decode_varint(&p, end);
+            if (p + len <= end)
+            {
+                hash = sexp_hash_bytes(p, (int)len);
+                add_key(keys, nkeys, capacity, make_atom_key(KEY_TYPE_STRING, hash), seen);
+            }
+            break;
+        }
+
+        case SEXP_TAG_LIST:
+        {
+            uint8 *p = ptr + 1;
+            uint32 count;
+            uint8 *data_start;
+            SEntry *sentries = NULL;
+            bool is_large_list;
+            uint32 i;
+
+            count = *ptr & SEXP_DATA_MASK;
+            is_large_list = (count == 0);
+
+            if (is_large_list)
+            {
+                if (p + 4 > end)
+                    return;
+                count = *(uint32 *)p;
+                p += 4;
+                p += 4;  /* Skip structural hash */
+                sentries = (SEntry *)p;
+                p += count * sizeof(SEntry);
+            }
+            else
+            {
+                (void)decode_varint(&p, end);  /* Skip size prefix */
+            }
+
+            data_start = p;
+
+            /* No structural keys for patterns - recurse into children only */
+            if (is_large_list && sentries)
+            {
+                for (i = 0; i < count && *nkeys < MAX_GIN_KEYS; i++)
+                {
+                    uint8 *elem_ptr = data_start + SENTRY_GET_OFFSET(sentries[i]);
+                    extract_pattern_keys_recursive(elem_ptr, end, symbols, sym_lengths, sym_count,
+                                                   keys, nkeys, capacity, seen);
+                }
+            }
+            else
+            {
+                uint8 *elem_ptr = data_start;
+                for (i = 0; i < count && elem_ptr < end && *nkeys < MAX_GIN_KEYS; i++)
+                {
+                    extract_pattern_keys_recursive(elem_ptr, end, symbols, sym_lengths, sym_count,
+                                                   keys, nkeys, capacity, seen);
+                    elem_ptr = sexp_skip_element(elem_ptr, end);
+                }
+            }
+            break;
+        }
+    }
+}
+
 /*
  * sexp_gin_extract_query - Extract GIN keys from a query value
  */
@@ -849,13 +1091,11 @@ sexp_gin_extract_query(PG_FUNCTION_ARGS)
     int         sym_count;
     char      **symbols;
     int        *sym_lengths;
-    char       *stack_symbols[SEXP_SMALL_SYMTAB_SIZE];
-    int         stack_lengths[SEXP_SMALL_SYMTAB_SIZE];
-    bool        use_stack;
     int         i;
-    KeyHashSet  seen;
-    bool        skip_pair_keys;
-    
+    GinExtractScratch *scratch;
+    bool        skip_pair_keys = false;
+    bool        pattern_mode = false;
+
     switch (strategy)
     {
         case SEXP_GIN_CONTAINS_STRATEGY:     /* @> structural */
@@ -875,7 +1115,16 @@ sexp_gin_extract_query(PG_FUNCTION_ARGS)
              */
             skip_pair_keys = true;
             break;
-            
+
+        case SEXP_GIN_MATCHES_STRATEGY:     /* @~ pattern match */
+            /*
+             * For pattern matching, only the pattern's literal atoms are
+             * valid pre-filter keys; wildcards and structural keys are
+             * handled by extract_pattern_keys_recursive below.
+             */
+            pattern_mode = true;
+            break;
+
         case SEXP_GIN_CONTAINED_STRATEGY:   /* <@ */
             /* For contained-by, use GIN_SEARCH_MODE_ALL */
             *searchMode = GIN_SEARCH_MODE_ALL;
@@ -886,55 +1135,74 @@ sexp_gin_extract_query(PG_FUNCTION_ARGS)
             elog(ERROR, "sexp_gin_extract_query: unknown strategy %d", strategy);
     }
     
-    /* Initialize */
-    keys = palloc(sizeof(int32) * 64);
-    capacity = 64;
-    key_hashset_init(&seen);
-    
+    /* Reuse the per-backend scratch (cleared hash set, warm key array) */
+    scratch = get_gin_scratch();
+    keys = scratch->keys;
+    capacity = scratch->capacity;
+
     data = SEXP_DATA_PTR(query);
     end = data + SEXP_DATA_SIZE(query);
     ptr = data;
-    
-    /* Read symbol table */
+
+    /* Skip v7 root metadata - keys come from the elements themselves */
+    if (SEXP_VERSION_HAS_ROOT_META(query->version))
+        ptr += SEXP_ROOT_META_SIZE_V(query->version);
+
+    /* Read symbol table into the warm scratch arrays */
     sym_count = (int)decode_varint(&ptr, end);
-    use_stack = (sym_count <= SEXP_SMALL_SYMTAB_SIZE);
-    
-    if (use_stack)
+    gin_scratch_ensure_symbols(scratch, sym_count);
+    symbols = scratch->symbols;
+    sym_lengths = scratch->sym_lengths;
+
+    if (SEXP_VERSION_HAS_DICT(query->version))
     {
-        symbols = stack_symbols;
-        sym_lengths = stack_lengths;
+        /* Dictionary symbol table: resolve varint IDs via the backend cache */
+        for (i = 0; i < sym_count; i++)
+        {
+            int32 id = (int32)(uint32) decode_varint(&ptr, end);
+            symbols[i] = sexp_dict_resolve(id, &sym_lengths[i], NULL);
+        }
     }
     else
     {
-        symbols = palloc(sizeof(char *) * sym_count);
-        sym_lengths = palloc(sizeof(int) * sym_count);
-    }
-    
-    for (i = 0; i < sym_count; i++)
-    {
-        int len = (int)decode_varint(&ptr, end);
-        symbols[i] = (char *)ptr;
-        sym_lengths[i] = len;
-        ptr += len;
-    }
-    
-    /* Extract keys - skip pair keys for @>> queries */
-    extract_query_keys_recursive(ptr, end, symbols, sym_lengths, sym_count,
-                                &keys, &key_count, &capacity, &seen, skip_pair_keys);
-    
-    /* Clean up symbol table if heap-allocated */
-    if (!use_stack)
-    {
-        pfree(symbols);
-        pfree(sym_lengths);
+        for (i = 0; i < sym_count; i++)
+        {
+            int len = (int)decode_varint(&ptr, end);
+            symbols[i] = (char *)ptr;
+            sym_lengths[i] = len;
+            ptr += len;
+        }
     }
-    
+
+    /* Extract keys - literal atoms only for patterns, skip pair keys for @>> */
+    if (pattern_mode)
+        extract_pattern_keys_recursive(ptr, end, symbols, sym_lengths, sym_count,
+                                       &keys, &key_count, &capacity, &scratch->seen);
+    else
+        extract_query_keys_recursive(ptr, end, symbols, sym_lengths, sym_count,
+                                    &keys, &key_count, &capacity, &scratch->seen, skip_pair_keys);
+
+    /* add_key may have grown the array - remember it for the next call */
+    scratch->keys = keys;
+    scratch->capacity = capacity;
+
     /* Set search mode - require ALL keys to match */
     *searchMode = GIN_SEARCH_MODE_DEFAULT;
     
     /* Convert to Datum array */
     if (key_count == 0)
     {
+        if (pattern_mode)
+        {
+            /*
+             * An all-wildcard pattern yields no literal keys, yet it can
+             * match any value.  Fall back to a full scan with recheck
+             * instead of probing for a key no stored value has.
+             */
+            *searchMode = GIN_SEARCH_MODE_ALL;
+            *nkeys = 0;
+            PG_RETURN_POINTER(NULL);
+        }
         *nkeys = 1;
         keys_out = palloc(sizeof(Datum));
         keys_out[0] = Int32GetDatum(make_atom_key(KEY_TYPE_ATOM, 0));
@@ -948,12 +1216,82 @@ sexp_gin_extract_query(PG_FUNCTION_ARGS)
             keys_out[i] = Int32GetDatum(keys[i]);
         }
     }
-    
-    pfree(keys);
-    
+
     PG_RETURN_POINTER(keys_out);
 }
 
+/*
+ * sexp_gin_query_key_count - count the GIN keys a query value produces.
+ *
+ * Used by the selectivity estimators in sexp_selfuncs.c as the query's
+ * specificity: each extra key an operand generates narrows the set of
+ * rows it can match. Going through the real extraction paths keeps the
+ * estimators' notion of "key" exactly the index's.
+ */
+int
+sexp_gin_query_key_count(Sexp *query, int strategy)
+{
+    GinExtractScratch *scratch;
+    int32      *keys;
+    int         key_count = 0;
+    int         capacity;
+    uint8      *data;
+    uint8      *end;
+    uint8      *ptr;
+    int         sym_count;
+    char      **symbols;
+    int        *sym_lengths;
+    int         i;
+
+    scratch = get_gin_scratch();
+    keys = scratch->keys;
+    capacity = scratch->capacity;
+
+    data = SEXP_DATA_PTR(query);
+    end = data + SEXP_DATA_SIZE(query);
+    ptr = data;
+
+    if (SEXP_VERSION_HAS_ROOT_META(query->version))
+        ptr += SEXP_ROOT_META_SIZE_V(query->version);
+
+    sym_count = (int)decode_varint(&ptr, end);
+    gin_scratch_ensure_symbols(scratch, sym_count);
+    symbols = scratch->symbols;
+    sym_lengths = scratch->sym_lengths;
+
+    if (SEXP_VERSION_HAS_DICT(query->version))
+    {
+        for (i = 0; i < sym_count; i++)
+        {
+            int32 id = (int32)(uint32) decode_varint(&ptr, end);
+            symbols[i] = sexp_dict_resolve(id, &sym_lengths[i], NULL);
+        }
+    }
+    else
+    {
+        for (i = 0; i < sym_count; i++)
+        {
+            int len = (int)decode_varint(&ptr, end);
+            symbols[i] = (char *)ptr;
+            sym_lengths[i] = len;
+            ptr += len;
+        }
+    }
+
+    if (strategy == SEXP_GIN_MATCHES_STRATEGY)
+        extract_pattern_keys_recursive(ptr, end, symbols, sym_lengths, sym_count,
+                                       &keys, &key_count, &capacity, &scratch->seen);
+    else
+        extract_query_keys_recursive(ptr, end, symbols, sym_lengths, sym_count,
+                                     &keys, &key_count, &capacity, &scratch->seen,
+                                     strategy == SEXP_GIN_CONTAINS_KEY_STRATEGY);
+
+    scratch->keys = keys;
+    scratch->capacity = capacity;
+
+    return key_count;
+}
+
 /*
  * sexp_gin_consistent - Check if indexed keys are consistent with query
  */
@@ -977,11 +1315,15 @@ sexp_gin_consistent(PG_FUNCTION_ARGS)
      * 2. Key presence is necessary but not sufficient for containment
      */
     *recheck = true;
+
+    SEXP_STAT_INC(gin_consistent_calls);
+    SEXP_STAT_INC(gin_rechecks);
     
     switch (strategy)
     {
         case SEXP_GIN_CONTAINS_STRATEGY:     /* @> structural */
         case SEXP_GIN_CONTAINS_KEY_STRATEGY: /* @>> key-based */
+        case SEXP_GIN_MATCHES_STRATEGY:      /* @~ pattern match */
             /* All query keys must be present in the indexed value */
             for (i = 0; i < nkeys; i++)
             {
@@ -1097,6 +1439,22 @@ sexp_gin_triconsistent(PG_FUNCTION_ARGS)
             }
             break;
             
+        case SEXP_GIN_MATCHES_STRATEGY:     /* @~ pattern match */
+            if (any_false)
+            {
+                result = GIN_FALSE;
+            }
+            else
+            {
+                /*
+                 * Never GIN_TRUE: literal-key presence shows the atoms
+                 * exist somewhere, but a pattern match also depends on
+                 * structure and positions, so a recheck is always needed.
+                 */
+                result = GIN_MAYBE;
+            }
+            break;
+
         case SEXP_GIN_CONTAINED_STRATEGY:   /* <@ */
             /* For contained-by, we can't efficiently pre-filter */
             result = GIN_MAYBE;
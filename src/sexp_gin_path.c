@@ -0,0 +1,403 @@
+/*
+ * sexp_gin_path.c
+ *
+ * Path-anchored GIN support for sexp type (sexp_path_ops)
+ *
+ * The default sexp_gin_ops opclass extracts position-blind keys: an atom
+ * produces the same key whether it sits at the document root or ten levels
+ * down. Head-anchored queries like "documents whose root head is define"
+ * or "value X under (config network ...)" therefore match huge candidate
+ * sets that the recheck has to throw away.
+ *
+ * KEY EXTRACTION STRATEGY (Path Chains):
+ * ======================================
+ * Analogous to jsonb_path_ops. Each atom leaf is keyed together with the
+ * chain of head symbols of its enclosing lists:
+ *
+ *   (config (network (port 8080)))
+ *     -> leaf 8080 under head-symbol path [config network port]
+ *
+ * Lists whose first element is a symbol extend the path with that symbol;
+ * other lists (pure data like (1 2 3)) leave the path unchanged, the way
+ * jsonb arrays do. Every symbol-headed list additionally gets a path-only
+ * key (path chain + list sentinel), so needles that name structure without
+ * leaf values, like (define), still produce a probe key.
+ *
+ * Because sexp containment is contains-ANYWHERE rather than root-anchored,
+ * stored values emit keys for every path SUFFIX up to
+ * PATH_OPS_SUFFIX_LEVELS components, while queries emit one key per leaf
+ * using their longest in-range suffix. A needle contained at any depth
+ * matches an equal subtree, so its root-relative paths are suffixes of the
+ * document's paths at the match site and the corresponding suffix keys are
+ * guaranteed to have been emitted. This trades index size (up to
+ * PATH_OPS_SUFFIX_LEVELS keys per leaf) for nearly recheck-free
+ * head/path-anchored containment.
+ *
+ * The opclass supports @> only; queries that cannot produce a path key
+ * (bare-atom needles) fall back to a full scan with recheck.
+ */
+
+#include "pg_sexp.h"
+#include "sexp_debug.h"
+#include "sexp_stats.h"
+#include "access/gin.h"
+#include "access/stratnum.h"
+#include "utils/builtins.h"
+
+/* Path suffix lengths emitted per leaf in stored values */
+#define PATH_OPS_SUFFIX_LEVELS 3
+
+/* Leaf-position sentinel for path-only keys of symbol-headed lists */
+#define PATH_OPS_LIST_SENTINEL 0xF1E2D3C4
+
+/* Maximum keys to extract from a single value (prevent explosion) */
+#define PATH_OPS_MAX_KEYS 3072
+
+PG_FUNCTION_INFO_V1(sexp_gin_path_extract_value);
+PG_FUNCTION_INFO_V1(sexp_gin_path_extract_query);
+PG_FUNCTION_INFO_V1(sexp_gin_path_consistent);
+PG_FUNCTION_INFO_V1(sexp_gin_path_triconsistent);
+
+/*
+ * Append a key, growing the array geometrically. Unlike sexp_gin.c's
+ * add_key there is no dedup set: GIN collapses duplicate keys itself, and
+ * path-chain keys repeat far less than flat atom keys do.
+ */
+static void
+path_ops_add_key(int32 **keys, int *nkeys, int *capacity, int32 key)
+{
+    if (*nkeys >= PATH_OPS_MAX_KEYS)
+        return;                 /* Safety limit */
+
+    if (*nkeys >= *capacity)
+    {
+        *capacity = (*capacity == 0) ? 64 : *capacity * 2;
+        *keys = repalloc(*keys, sizeof(int32) * (*capacity));
+    }
+
+    (*keys)[(*nkeys)++] = key;
+}
+
+/*
+ * Emit keys for one leaf (or list sentinel) under the given head-symbol
+ * path. Stored values emit every suffix length up to
+ * PATH_OPS_SUFFIX_LEVELS; queries emit only their longest in-range suffix,
+ * which is the most selective key a matching document is guaranteed to
+ * carry.
+ */
+static void
+path_ops_emit(uint32 *path, int depth, uint32 leaf_hash, bool query_mode,
+              int32 **keys, int *nkeys, int *capacity)
+{
+    int min_len, max_len;
+    int len;
+
+    max_len = Min(depth, PATH_OPS_SUFFIX_LEVELS);
+    min_len = query_mode ? max_len : 1;
+
+    for (len = min_len; len <= max_len; len++)
+    {
+        uint32 h = 0;
+        int i;
+
+        for (i = depth - len; i < depth; i++)
+            h = hash_combine(h, path[i]);
+
+        path_ops_add_key(keys, nkeys, capacity,
+                         (int32) hash_combine(h, leaf_hash));
+    }
+}
+
+/*
+ * Recursive walk emitting path-chain keys.
+ *
+ * path[] holds the hashes of enclosing head symbols; depth is the number
+ * of valid entries. nest tracks raw nesting independently of the symbol
+ * path so pathological all-list documents cannot overflow the C stack.
+ */
+static void
+path_ops_extract(SexpReadState *state, uint8 *ptr, uint8 *end,
+                 uint32 *path, int depth, int nest, bool query_mode,
+                 int32 **keys, int *nkeys, int *capacity)
+{
+    uint8 byte;
+    uint8 tag;
+    uint64 count;
+    uint8 *data_start;
+    SEntry *sentries = NULL;
+    uint8 *p;
+    uint64 first_child = 0;
+    uint64 i;
+
+    if (ptr >= end || *nkeys >= PATH_OPS_MAX_KEYS || nest >= SEXP_MAX_DEPTH)
+        return;
+
+    byte = *ptr;
+    tag = byte & SEXP_TAG_MASK;
+
+    if (tag != SEXP_TAG_LIST)
+    {
+        /* Atom leaf: key it under the current path */
+        uint32 leaf_hash = sexp_element_hash(ptr, end, state->symbols,
+                                             state->sym_lengths,
+                                             state->sym_count);
+
+        path_ops_emit(path, depth, leaf_hash, query_mode,
+                      keys, nkeys, capacity);
+        return;
+    }
+
+    /* Decode list header */
+    p = ptr + 1;
+    count = byte & SEXP_DATA_MASK;
+    if (unlikely(count == 0))
+    {
+        uint32 cnt32 = SEXP_LOAD_UINT32_UNALIGNED(p);
+
+        p += sizeof(uint32);
+        count = cnt32;
+        p += sizeof(uint32);    /* Skip hash */
+        sentries = (SEntry *) p;
+        p += count * sizeof(SEntry);
+    }
+    else
+    {
+        /* Small list v6: skip size prefix */
+        (void) decode_varint(&p, end);
+    }
+    data_start = p;
+
+    if (count == 0)
+        return;                 /* Defensive: parser emits NIL instead */
+
+    /* A symbol head extends the path for the remaining children */
+    if ((*data_start & SEXP_TAG_MASK) == SEXP_TAG_SYMBOL_REF &&
+        depth < SEXP_MAX_DEPTH)
+    {
+        uint8 *hp = data_start + 1;
+        uint64 idx = decode_varint(&hp, end);
+
+        if ((int) idx < state->sym_count && state->sym_hashes != NULL)
+        {
+            path[depth] = state->sym_hashes[idx];
+            depth++;
+            first_child = 1;
+
+            /*
+             * Path-only key: lets needles that name structure without
+             * leaf values, like (define) or (config (network)), probe
+             * the index instead of scanning.
+             */
+            path_ops_emit(path, depth, PATH_OPS_LIST_SENTINEL, query_mode,
+                          keys, nkeys, capacity);
+        }
+    }
+
+    /* Recurse into children at the (possibly extended) path */
+    if (sentries != NULL)
+    {
+        for (i = first_child; i < count && *nkeys < PATH_OPS_MAX_KEYS; i++)
+        {
+            uint8 *child = data_start + SENTRY_GET_OFFSET(sentries[i]);
+
+            path_ops_extract(state, child, end, path, depth, nest + 1,
+                             query_mode, keys, nkeys, capacity);
+        }
+    }
+    else
+    {
+        uint8 *child = data_start;
+
+        for (i = 0; i < count && child < end && *nkeys < PATH_OPS_MAX_KEYS; i++)
+        {
+            if (i >= first_child)
+                path_ops_extract(state, child, end, path, depth, nest + 1,
+                                 query_mode, keys, nkeys, capacity);
+            child = sexp_skip_element(child, end);
+        }
+    }
+}
+
+/*
+ * Shared driver for value and query extraction: decode the read state,
+ * walk the root element, return the key array.
+ */
+static int32 *
+path_ops_extract_keys(Sexp *sexp, bool query_mode, int *key_count)
+{
+    SexpReadState state;
+    uint32 *path;
+    int32 *keys;
+    int nkeys = 0;
+    int capacity = 64;
+
+    sexp_init_read_state(&state, sexp);
+
+    path = palloc(sizeof(uint32) * SEXP_MAX_DEPTH);
+    keys = palloc(sizeof(int32) * capacity);
+
+    path_ops_extract(&state, state.ptr, state.end, path, 0, 0, query_mode,
+                     &keys, &nkeys, &capacity);
+
+    pfree(path);
+    sexp_free_read_state(&state);
+
+    *key_count = nkeys;
+    return keys;
+}
+
+/*
+ * sexp_gin_path_extract_value - Extract path-chain keys from a stored value
+ */
+Datum
+sexp_gin_path_extract_value(PG_FUNCTION_ARGS)
+{
+    Sexp       *sexp = PG_GETARG_SEXP(0);
+    int32      *nkeys = (int32 *) PG_GETARG_POINTER(1);
+    Datum      *keys_out;
+    int32      *keys;
+    int         key_count;
+    int         i;
+
+    keys = path_ops_extract_keys(sexp, false, &key_count);
+
+    SEXP_STAT_INC(gin_values_indexed);
+    SEXP_STAT_ADD(gin_keys_emitted, key_count);
+
+    /* Convert to Datum array */
+    if (key_count == 0)
+    {
+        /* Pathless values (bare atoms) get a fixed placeholder key */
+        *nkeys = 1;
+        keys_out = palloc(sizeof(Datum));
+        keys_out[0] = Int32GetDatum((int32) PATH_OPS_LIST_SENTINEL);
+    }
+    else
+    {
+        *nkeys = key_count;
+        keys_out = palloc(sizeof(Datum) * key_count);
+        for (i = 0; i < key_count; i++)
+            keys_out[i] = Int32GetDatum(keys[i]);
+    }
+
+    pfree(keys);
+    PG_RETURN_POINTER(keys_out);
+}
+
+/*
+ * sexp_gin_path_extract_query - Extract path-chain keys from a query value
+ */
+Datum
+sexp_gin_path_extract_query(PG_FUNCTION_ARGS)
+{
+    Sexp       *query = PG_GETARG_SEXP(0);
+    int32      *nkeys = (int32 *) PG_GETARG_POINTER(1);
+    StrategyNumber strategy = PG_GETARG_UINT16(2);
+    int32      *searchMode = (int32 *) PG_GETARG_POINTER(6);
+    Datum      *keys_out;
+    int32      *keys;
+    int         key_count;
+    int         i;
+
+    if (strategy != SEXP_GIN_CONTAINS_STRATEGY)
+        elog(ERROR, "sexp_gin_path_extract_query: unknown strategy %d",
+             strategy);
+
+    keys = path_ops_extract_keys(query, true, &key_count);
+
+    /* Set search mode - require ALL keys to match */
+    *searchMode = GIN_SEARCH_MODE_DEFAULT;
+
+    if (key_count == 0)
+    {
+        /*
+         * A needle with no head-symbol structure (a bare atom, or lists
+         * with non-symbol heads only) produces no path keys. Fall back to
+         * a full scan with recheck; the default sexp_gin_ops opclass is
+         * the better tool for those queries.
+         */
+        pfree(keys);
+        *searchMode = GIN_SEARCH_MODE_ALL;
+        *nkeys = 0;
+        PG_RETURN_POINTER(NULL);
+    }
+
+    *nkeys = key_count;
+    keys_out = palloc(sizeof(Datum) * key_count);
+    for (i = 0; i < key_count; i++)
+        keys_out[i] = Int32GetDatum(keys[i]);
+
+    pfree(keys);
+    PG_RETURN_POINTER(keys_out);
+}
+
+/*
+ * sexp_gin_path_consistent - Check if indexed keys are consistent with query
+ */
+Datum
+sexp_gin_path_consistent(PG_FUNCTION_ARGS)
+{
+    bool       *check = (bool *) PG_GETARG_POINTER(0);
+    StrategyNumber strategy = PG_GETARG_UINT16(1);
+    int32       nkeys = PG_GETARG_INT32(3);
+    bool       *recheck = (bool *) PG_GETARG_POINTER(5);
+    bool        result = true;
+    int         i;
+
+    if (strategy != SEXP_GIN_CONTAINS_STRATEGY)
+        elog(ERROR, "sexp_gin_path_consistent: unknown strategy %d", strategy);
+
+    /*
+     * Always recheck: keys are hashes and path-chain presence does not
+     * prove the needle's internal ordering and counts. The point of this
+     * opclass is that the candidate set reaching the recheck is small.
+     */
+    *recheck = true;
+
+    SEXP_STAT_INC(gin_consistent_calls);
+    SEXP_STAT_INC(gin_rechecks);
+
+    /* All query keys must be present in the indexed value */
+    for (i = 0; i < nkeys; i++)
+    {
+        if (!check[i])
+        {
+            result = false;
+            break;
+        }
+    }
+
+    PG_RETURN_BOOL(result);
+}
+
+/*
+ * sexp_gin_path_triconsistent - Ternary consistent check for GIN
+ *
+ * Never returns GIN_TRUE: a path-chain key proves "this value exists under
+ * this head chain somewhere", but @> also requires the needle's sibling
+ * structure, so a recheck is always needed on surviving candidates.
+ */
+Datum
+sexp_gin_path_triconsistent(PG_FUNCTION_ARGS)
+{
+    GinTernaryValue *check = (GinTernaryValue *) PG_GETARG_POINTER(0);
+    StrategyNumber strategy = PG_GETARG_UINT16(1);
+    int32       nkeys = PG_GETARG_INT32(3);
+    GinTernaryValue result = GIN_MAYBE;
+    int         i;
+
+    if (strategy != SEXP_GIN_CONTAINS_STRATEGY)
+        elog(ERROR, "sexp_gin_path_triconsistent: unknown strategy %d",
+             strategy);
+
+    for (i = 0; i < nkeys; i++)
+    {
+        if (check[i] == GIN_FALSE)
+        {
+            result = GIN_FALSE;
+            break;
+        }
+    }
+
+    PG_RETURN_GIN_TERNARY_VALUE(result);
+}
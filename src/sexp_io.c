@@ -10,10 +10,156 @@
 #include <string.h>
 #include <math.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 /* Forward declarations */
 static void output_element(SexpReadState *state, StringInfo buf);
+static Size output_size_element(uint8 **pp, uint8 *end, SexpReadState *state);
 static void init_read_state_internal(SexpReadState *state, uint8 *data, int len);
 
+/*
+ * ============================================================================
+ * STRING ESCAPE SCANNING
+ * ============================================================================
+ *
+ * Serializing a string previously examined one byte at a time, appending
+ * each clean character individually. On string-heavy documents the per-char
+ * escape checks dominate sexp_out. The scanner below locates the first byte
+ * needing an escape - { \t, \n, \r, '\\', '"' } - so clean runs can be
+ * bulk-copied with a single appendBinaryStringInfo. SIMD variants classify
+ * 16 (SSE2) or 32 (AVX2) bytes per iteration in the same style as the
+ * parser's tokenizer scanners; the scalar loop alone serves other builds.
+ *
+ * Note the escape set is exactly the five characters output_element escaped
+ * before: \v and \f are not escaped and must pass through unchanged, so a
+ * 0x09-0x0D range test would be wrong here.
+ */
+
+static inline bool
+is_escape_char(uint8 c)
+{
+    return c == '\n' || c == '\t' || c == '\r' || c == '\\' || c == '"';
+}
+
+#if defined(__AVX2__)
+
+static const char *
+scan_escape_end(const char *p, const char *end)
+{
+    const __m256i v_nl = _mm256_set1_epi8('\n');
+    const __m256i v_tab = _mm256_set1_epi8('\t');
+    const __m256i v_cr = _mm256_set1_epi8('\r');
+    const __m256i v_bslash = _mm256_set1_epi8('\\');
+    const __m256i v_quote = _mm256_set1_epi8('"');
+
+    while (p + 32 <= end)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) p);
+        __m256i esc = _mm256_or_si256(_mm256_cmpeq_epi8(v, v_nl),
+                                      _mm256_cmpeq_epi8(v, v_tab));
+        esc = _mm256_or_si256(esc, _mm256_cmpeq_epi8(v, v_cr));
+        esc = _mm256_or_si256(esc, _mm256_cmpeq_epi8(v, v_bslash));
+        esc = _mm256_or_si256(esc, _mm256_cmpeq_epi8(v, v_quote));
+        {
+            uint32 mask = (uint32) _mm256_movemask_epi8(esc);
+
+            if (mask != 0)
+                return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+
+    while (p < end && !is_escape_char((uint8) *p))
+        p++;
+    return p;
+}
+
+#elif defined(__SSE2__)
+
+static const char *
+scan_escape_end(const char *p, const char *end)
+{
+    const __m128i v_nl = _mm_set1_epi8('\n');
+    const __m128i v_tab = _mm_set1_epi8('\t');
+    const __m128i v_cr = _mm_set1_epi8('\r');
+    const __m128i v_bslash = _mm_set1_epi8('\\');
+    const __m128i v_quote = _mm_set1_epi8('"');
+
+    while (p + 16 <= end)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        __m128i esc = _mm_or_si128(_mm_cmpeq_epi8(v, v_nl),
+                                   _mm_cmpeq_epi8(v, v_tab));
+        esc = _mm_or_si128(esc, _mm_cmpeq_epi8(v, v_cr));
+        esc = _mm_or_si128(esc, _mm_cmpeq_epi8(v, v_bslash));
+        esc = _mm_or_si128(esc, _mm_cmpeq_epi8(v, v_quote));
+        {
+            uint32 mask = (uint32) _mm_movemask_epi8(esc);
+
+            if (mask != 0)
+                return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+
+    while (p < end && !is_escape_char((uint8) *p))
+        p++;
+    return p;
+}
+
+#else
+
+static const char *
+scan_escape_end(const char *p, const char *end)
+{
+    while (p < end && !is_escape_char((uint8) *p))
+        p++;
+    return p;
+}
+
+#endif
+
+/*
+ * Append a quoted, escaped string: clean runs are located with the
+ * vectorized scanner and bulk-copied; only escape characters take the
+ * per-char path.
+ */
+static void
+output_escaped_string(StringInfo buf, const char *p, int len)
+{
+    const char *end = p + len;
+
+    appendStringInfoChar(buf, '"');
+    while (p < end)
+    {
+        const char *run = scan_escape_end(p, end);
+
+        if (run > p)
+        {
+            appendBinaryStringInfo(buf, p, run - p);
+            p = run;
+        }
+        if (p < end)
+        {
+            switch (*p)
+            {
+                case '\n': appendStringInfoString(buf, "\\n"); break;
+                case '\t': appendStringInfoString(buf, "\\t"); break;
+                case '\r': appendStringInfoString(buf, "\\r"); break;
+                case '\\': appendStringInfoString(buf, "\\\\"); break;
+                case '"':  appendStringInfoString(buf, "\\\""); break;
+            }
+            p++;
+        }
+    }
+    appendStringInfoChar(buf, '"');
+}
+
 /* Singleton NIL sexp - allocated once in TopMemoryContext */
 static Sexp *nil_singleton = NULL;
 
@@ -33,11 +179,12 @@ sexp_get_nil_singleton(void)
         
         old_ctx = MemoryContextSwitchTo(TopMemoryContext);
         
-        /* nil = version(1) + sym_count(1, varint 0) + nil_tag(1) */
+        /* nil = version(1) + sym_count(1, varint 0) + nil_tag(1)
+         * Written as v6: a root hash/Bloom header buys nothing for NIL. */
         total_size = VARHDRSZ + 3;
         nil_singleton = (Sexp *) palloc(total_size);
         SET_VARSIZE(nil_singleton, total_size);
-        nil_singleton->version = SEXP_FORMAT_VERSION;
+        nil_singleton->version = SEXP_FORMAT_VERSION_V6;
         nil_singleton->data[0] = 0;  /* 0 symbols (varint) */
         nil_singleton->data[1] = SEXP_TAG_NIL;
         
@@ -88,7 +235,37 @@ init_read_state_internal(SexpReadState *state, uint8 *data, int len)
     /* Validate and skip version byte */
     SEXP_CHECK_VERSION(data[0]);
     state->ptr++;
-    
+
+    /* v7 root metadata header: stored structural hash + Bloom signature
+     * (1, 2 or 4 words wide per the version byte's width bits) */
+    if (SEXP_VERSION_HAS_ROOT_META(data[0]) &&
+        SEXP_BLOOM_NWORDS(data[0]) <= SEXP_BLOOM_MAX_WORDS &&
+        state->ptr + SEXP_ROOT_META_SIZE_V(data[0]) <= state->end)
+    {
+        int nwords = SEXP_BLOOM_NWORDS(data[0]);
+        int w;
+
+        memcpy(&state->root_hash, state->ptr, sizeof(uint32));
+        bloom_wide_init(&state->root_bloom_wide, nwords);
+        memcpy(state->root_bloom_wide.words, state->ptr + sizeof(uint32),
+               nwords * sizeof(uint64));
+
+        /* Keep the folded 64-bit signature for narrow-width consumers */
+        state->root_bloom = 0;
+        for (w = 0; w < nwords; w++)
+            state->root_bloom |= state->root_bloom_wide.words[w];
+
+        state->has_root_meta = true;
+        state->ptr += SEXP_ROOT_META_SIZE_V(data[0]);
+    }
+    else
+    {
+        state->has_root_meta = false;
+        state->root_hash = 0;
+        state->root_bloom = 0;
+        bloom_wide_init(&state->root_bloom_wide, 1);
+    }
+
     /* Read symbol table */
     sym_count = decode_varint(&state->ptr, state->end);
     state->sym_count = (int)sym_count;
@@ -111,14 +288,33 @@ init_read_state_internal(SexpReadState *state, uint8 *data, int len)
             state->use_stack = false;
         }
         
-        for (i = 0; i < state->sym_count; i++)
+        if (SEXP_VERSION_HAS_DICT(data[0]))
         {
-            uint64 slen = decode_varint(&state->ptr, state->end);
-            state->sym_lengths[i] = (int)slen;
-            state->symbols[i] = (char *)state->ptr;
-            /* Pre-compute symbol hash for fast comparison using PostgreSQL hash_bytes */
-            state->sym_hashes[i] = hash_bytes((const unsigned char *)state->ptr, (int)slen);
-            state->ptr += slen;
+            /*
+             * Dictionary symbol table: entries are varint IDs resolved
+             * through the per-backend cache. Resolved strings and their
+             * hashes are cache-owned and long-lived, so downstream code
+             * sees exactly the same arrays as for inline tables.
+             */
+            for (i = 0; i < state->sym_count; i++)
+            {
+                int32 id = (int32)(uint32) decode_varint(&state->ptr, state->end);
+                state->symbols[i] = sexp_dict_resolve(id,
+                                                      &state->sym_lengths[i],
+                                                      &state->sym_hashes[i]);
+            }
+        }
+        else
+        {
+            for (i = 0; i < state->sym_count; i++)
+            {
+                uint64 slen = decode_varint(&state->ptr, state->end);
+                state->sym_lengths[i] = (int)slen;
+                state->symbols[i] = (char *)state->ptr;
+                /* Pre-compute symbol hash for fast comparison using PostgreSQL hash_bytes */
+                state->sym_hashes[i] = hash_bytes((const unsigned char *)state->ptr, (int)slen);
+                state->ptr += slen;
+            }
         }
     }
     else
@@ -228,11 +424,18 @@ sexp_to_cstring(Sexp *sexp)
     
     initStringInfo(&buf);
     sexp_init_read_state(&state, sexp);
-    
+
+    /* Size the buffer once from the binary encoding, then stream */
+    {
+        uint8 *size_ptr = state.ptr;
+
+        enlargeStringInfo(&buf, output_size_element(&size_ptr, state.end,
+                                                    &state));
+    }
     output_element(&state, &buf);
-    
+
     sexp_free_read_state(&state);
-    
+
     return buf.data;
 }
 
@@ -243,8 +446,14 @@ void
 sexp_to_string_internal(Sexp *sexp, char *data, int len, StringInfo buf)
 {
     SexpReadState state;
-    
+
     sexp_init_read_state(&state, sexp);
+    {
+        uint8 *size_ptr = state.ptr;
+
+        enlargeStringInfo(buf, output_size_element(&size_ptr, state.end,
+                                                   &state));
+    }
     output_element(&state, buf);
     sexp_free_read_state(&state);
 }
@@ -320,46 +529,22 @@ output_element(SexpReadState *state, StringInfo buf)
         case SEXP_TAG_SHORT_STRING:
         {
             int slen = byte & SEXP_DATA_MASK;
-            int i;
-            
-            appendStringInfoChar(buf, '"');
-            for (i = 0; i < slen && state->ptr < state->end; i++)
-            {
-                char c = *state->ptr++;
-                switch (c)
-                {
-                    case '\n': appendStringInfoString(buf, "\\n"); break;
-                    case '\t': appendStringInfoString(buf, "\\t"); break;
-                    case '\r': appendStringInfoString(buf, "\\r"); break;
-                    case '\\': appendStringInfoString(buf, "\\\\"); break;
-                    case '"':  appendStringInfoString(buf, "\\\""); break;
-                    default:   appendStringInfoChar(buf, c); break;
-                }
-            }
-            appendStringInfoChar(buf, '"');
+
+            if (slen > state->end - state->ptr)
+                slen = state->end - state->ptr;
+            output_escaped_string(buf, (const char *) state->ptr, slen);
+            state->ptr += slen;
             break;
         }
-        
+
         case SEXP_TAG_LONG_STRING:
         {
             uint64 slen = decode_varint(&state->ptr, state->end);
-            uint64 i;
-            
-            appendStringInfoChar(buf, '"');
-            for (i = 0; i < slen && state->ptr < state->end; i++)
-            {
-                char c = *state->ptr++;
-                switch (c)
-                {
-                    case '\n': appendStringInfoString(buf, "\\n"); break;
-                    case '\t': appendStringInfoString(buf, "\\t"); break;
-                    case '\r': appendStringInfoString(buf, "\\r"); break;
-                    case '\\': appendStringInfoString(buf, "\\\\"); break;
-                    case '"':  appendStringInfoString(buf, "\\\""); break;
-                    default:   appendStringInfoChar(buf, c); break;
-                }
-            }
-            appendStringInfoChar(buf, '"');
+
+            if (slen > (uint64) (state->end - state->ptr))
+                slen = state->end - state->ptr;
+            output_escaped_string(buf, (const char *) state->ptr, (int) slen);
+            state->ptr += slen;
             break;
         }
         
@@ -408,3 +593,414 @@ output_element(SexpReadState *state, StringInfo buf)
             break;
     }
 }
+
+/*
+ * Size pre-pass over the binary encoding.
+ *
+ * Walks the element at *pp and returns an upper bound on its text length,
+ * so the output buffer can be sized with a single enlargeStringInfo instead
+ * of repeated doublings while a multi-megabyte document streams in. Symbol
+ * and string sizes are exact (escapes are counted with the same scanner the
+ * emitter uses, on bytes that stay cache-warm for the emit pass); numbers
+ * use their worst-case formatted widths since formatting them here would
+ * cost the printf we are trying to pay only once.
+ *
+ * Advances *pp past the element, mirroring output_element's walk.
+ */
+#define SEXP_OUT_SMALLINT_MAX_LEN  3    /* "-16" */
+#define SEXP_OUT_INTEGER_MAX_LEN   20   /* "-9223372036854775808" */
+#define SEXP_OUT_FLOAT_MAX_LEN     26   /* "%.17g" worst case, "-inf", "nan" */
+
+static Size
+output_size_element(uint8 **pp, uint8 *end, SexpReadState *state)
+{
+    uint8 *p = *pp;
+    uint8 byte;
+    uint8 tag;
+    Size size = 0;
+
+    if (p >= end)
+        return 2;  /* "()" */
+
+    byte = *p++;
+    tag = byte & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+            size = 2;
+            break;
+
+        case SEXP_TAG_SMALLINT:
+            size = SEXP_OUT_SMALLINT_MAX_LEN;
+            break;
+
+        case SEXP_TAG_INTEGER:
+            (void) decode_varint(&p, end);
+            size = SEXP_OUT_INTEGER_MAX_LEN;
+            break;
+
+        case SEXP_TAG_FLOAT:
+            p += sizeof(float8);
+            size = SEXP_OUT_FLOAT_MAX_LEN;
+            break;
+
+        case SEXP_TAG_SYMBOL_REF:
+        {
+            uint64 idx = decode_varint(&p, end);
+
+            if ((int) idx < state->sym_count)
+                size = state->sym_lengths[idx];
+            else
+                size = 16;  /* "?invalid-symbol?" */
+            break;
+        }
+
+        case SEXP_TAG_SHORT_STRING:
+        case SEXP_TAG_LONG_STRING:
+        {
+            uint64 slen;
+            const char *s;
+            const char *s_end;
+
+            if (tag == SEXP_TAG_SHORT_STRING)
+                slen = byte & SEXP_DATA_MASK;
+            else
+                slen = decode_varint(&p, end);
+            if (slen > (uint64) (end - p))
+                slen = end - p;
+
+            /* Quotes + content + one extra byte per escaped character */
+            size = 2 + slen;
+            s = (const char *) p;
+            s_end = s + slen;
+            while (s < s_end)
+            {
+                s = scan_escape_end(s, s_end);
+                if (s < s_end)
+                {
+                    size++;
+                    s++;
+                }
+            }
+            p += slen;
+            break;
+        }
+
+        case SEXP_TAG_LIST:
+        {
+            uint64 count = byte & SEXP_DATA_MASK;
+            uint64 i;
+
+            if (unlikely(count == 0))
+            {
+                uint32 cnt32 = SEXP_LOAD_UINT32_UNALIGNED(p);
+                p += sizeof(uint32);
+                count = cnt32;
+                p += sizeof(uint32);            /* structural hash */
+                p += count * sizeof(SEntry);    /* SEntry table */
+            }
+            else
+                (void) decode_varint(&p, end);
+
+            /* Parens + separators + children */
+            size = 2 + (count > 0 ? count - 1 : 0);
+            for (i = 0; i < count; i++)
+                size += output_size_element(&p, end, state);
+            break;
+        }
+    }
+
+    *pp = p;
+    return size;
+}
+
+/*
+ * ===========================================================================
+ * BINARY INPUT VALIDATION
+ * ===========================================================================
+ *
+ * sexp_recv accepts wire bytes from binary COPY and replication without a
+ * text round-trip, so nothing else has vetted them. The validator below
+ * makes a single streaming pass over the encoding - no intermediate
+ * structure is built - and rejects anything a later reader could trip
+ * over: truncated varints, out-of-range symbol references, SEntry offsets
+ * that are non-monotonic or point outside the element data, and nesting
+ * beyond SEXP_MAX_DEPTH. After it passes, readers may trust offsets and
+ * lengths without re-checking.
+ */
+
+#define SEXP_VALIDATE_ERROR(...) \
+    ereport(ERROR, \
+            (errcode(ERRCODE_DATA_CORRUPTED), \
+             errmsg("invalid sexp binary data: " __VA_ARGS__)))
+
+/*
+ * Decode a varint with strict bounds and termination checking.
+ * Returns pointer past the varint; errors out on truncation or overflow.
+ */
+static const uint8 *
+validate_varint(const uint8 *p, const uint8 *end, uint64 *out)
+{
+    uint64 value = 0;
+    int shift = 0;
+
+    while (p < end)
+    {
+        uint8 byte = *p++;
+
+        if (shift >= 64)
+            SEXP_VALIDATE_ERROR("varint too long");
+        value |= ((uint64)(byte & 0x7F)) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *out = value;
+            return p;
+        }
+        shift += 7;
+    }
+
+    SEXP_VALIDATE_ERROR("truncated varint");
+    return NULL;                /* keep compiler quiet */
+}
+
+/* Expected SEntry type bits for an element's first byte */
+static uint32
+validate_sentry_type_for_byte(uint8 byte)
+{
+    switch (byte & SEXP_TAG_MASK)
+    {
+        case SEXP_TAG_NIL:
+            return SENTRY_TYPE_NIL;
+        case SEXP_TAG_SMALLINT:
+        case SEXP_TAG_INTEGER:
+            return SENTRY_TYPE_INTEGER;
+        case SEXP_TAG_FLOAT:
+            return SENTRY_TYPE_FLOAT;
+        case SEXP_TAG_SYMBOL_REF:
+            return SENTRY_TYPE_SYMBOL;
+        case SEXP_TAG_SHORT_STRING:
+        case SEXP_TAG_LONG_STRING:
+            return SENTRY_TYPE_STRING;
+        default:
+            return SENTRY_TYPE_LIST;
+    }
+}
+
+/*
+ * Validate one element starting at p; returns pointer past the element.
+ */
+static const uint8 *
+validate_element(const uint8 *p, const uint8 *end, uint64 sym_count, int depth)
+{
+    uint8 byte;
+    uint8 tag;
+
+    SEXP_CHECK_DEPTH(depth);
+
+    if (p >= end)
+        SEXP_VALIDATE_ERROR("truncated element");
+
+    byte = *p++;
+    tag = byte & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+        case SEXP_TAG_SMALLINT:
+            return p;
+
+        case SEXP_TAG_INTEGER:
+        {
+            uint64 dummy;
+
+            return validate_varint(p, end, &dummy);
+        }
+
+        case SEXP_TAG_FLOAT:
+            if (p + sizeof(float8) > end)
+                SEXP_VALIDATE_ERROR("truncated float");
+            return p + sizeof(float8);
+
+        case SEXP_TAG_SYMBOL_REF:
+        {
+            uint64 idx;
+
+            p = validate_varint(p, end, &idx);
+            if (idx >= sym_count)
+                SEXP_VALIDATE_ERROR("symbol index %llu out of range (table has %llu)",
+                                    (unsigned long long) idx,
+                                    (unsigned long long) sym_count);
+            return p;
+        }
+
+        case SEXP_TAG_SHORT_STRING:
+        {
+            int len = byte & SEXP_DATA_MASK;
+
+            if (p + len > end)
+                SEXP_VALIDATE_ERROR("truncated string");
+            return p + len;
+        }
+
+        case SEXP_TAG_LONG_STRING:
+        {
+            uint64 len;
+
+            p = validate_varint(p, end, &len);
+            if (len > SEXP_MAX_REASONABLE_STRING_LEN || p + len > end)
+                SEXP_VALIDATE_ERROR("truncated or oversized string");
+            return p + len;
+        }
+
+        case SEXP_TAG_LIST:
+        default:
+        {
+            uint64 count = byte & SEXP_DATA_MASK;
+
+            if (count > 0)
+            {
+                /* Small list: size prefix, then `count` sequential elements */
+                uint64 payload_size;
+                const uint8 *payload_end;
+                uint64 i;
+
+                p = validate_varint(p, end, &payload_size);
+                if (payload_size > (uint64)(end - p))
+                    SEXP_VALIDATE_ERROR("list payload exceeds data");
+                payload_end = p + payload_size;
+
+                for (i = 0; i < count; i++)
+                    p = validate_element(p, payload_end, sym_count, depth + 1);
+
+                if (p != payload_end)
+                    SEXP_VALIDATE_ERROR("list payload size mismatch");
+                return p;
+            }
+            else
+            {
+                /* Large list: count + hash + SEntry table + elements */
+                uint32 cnt;
+                const uint8 *sentries;
+                const uint8 *data_start;
+                uint32 prev_offset = 0;
+                uint32 i;
+
+                if (p + 2 * sizeof(uint32) > end)
+                    SEXP_VALIDATE_ERROR("truncated list header");
+                memcpy(&cnt, p, sizeof(uint32));
+                p += 2 * sizeof(uint32);        /* count + structural hash */
+
+                if (cnt == 0 || cnt > SEXP_MAX_REASONABLE_LIST_COUNT)
+                    SEXP_VALIDATE_ERROR("unreasonable list count %u", cnt);
+                if ((uint64)cnt * sizeof(SEntry) > (uint64)(end - p))
+                    SEXP_VALIDATE_ERROR("truncated SEntry table");
+
+                sentries = p;
+                data_start = p + (uint64)cnt * sizeof(SEntry);
+
+                for (i = 0; i < cnt; i++)
+                {
+                    SEntry se;
+                    uint32 offset;
+                    const uint8 *elem;
+
+                    memcpy(&se, sentries + i * sizeof(SEntry), sizeof(SEntry));
+                    offset = SENTRY_GET_OFFSET(se);
+
+                    /* Offsets must start at 0 and strictly increase */
+                    if (i == 0 ? offset != 0 : offset <= prev_offset)
+                        SEXP_VALIDATE_ERROR("non-monotonic SEntry offset");
+                    if (offset >= (uint32)(end - data_start))
+                        SEXP_VALIDATE_ERROR("SEntry offset out of bounds");
+                    prev_offset = offset;
+
+                    elem = data_start + offset;
+                    if (SENTRY_GET_TYPE(se) != validate_sentry_type_for_byte(*elem))
+                        SEXP_VALIDATE_ERROR("SEntry type does not match element");
+
+                    p = validate_element(elem, end, sym_count, depth + 1);
+
+                    /* Each element must end exactly where the next begins */
+                    if (i + 1 < cnt)
+                    {
+                        SEntry next;
+                        uint32 next_offset;
+
+                        memcpy(&next, sentries + (i + 1) * sizeof(SEntry), sizeof(SEntry));
+                        next_offset = SENTRY_GET_OFFSET(next);
+                        if (p != data_start + next_offset)
+                            SEXP_VALIDATE_ERROR("SEntry offsets do not tile element data");
+                    }
+                }
+                return p;
+            }
+        }
+    }
+}
+
+/*
+ * sexp_validate_binary - Validate an untrusted binary sexp encoding.
+ *
+ * data/len cover the bytes after the varlena header (version byte first).
+ * Errors out with ERRCODE_DATA_CORRUPTED on any structural problem.
+ */
+void
+sexp_validate_binary(const uint8 *data, int len)
+{
+    const uint8 *p = data;
+    const uint8 *end = data + len;
+    uint64 sym_count;
+    uint64 i;
+
+    if (len < 2)
+        SEXP_VALIDATE_ERROR("data too short");
+
+    SEXP_CHECK_VERSION(p[0]);
+    if ((p[0] & SEXP_FLAG_BLOOM_WIDTH) == SEXP_FLAG_BLOOM_WIDTH)
+        SEXP_VALIDATE_ERROR("reserved Bloom width code");
+    if (SEXP_VERSION_HAS_ROOT_META(p[0]) &&
+        len < 1 + (int) SEXP_ROOT_META_SIZE_V(p[0]) + 1)
+        SEXP_VALIDATE_ERROR("data too short for root metadata");
+    p++;
+    if (SEXP_VERSION_HAS_ROOT_META(data[0]))
+        p += SEXP_ROOT_META_SIZE_V(data[0]);
+
+    /* Symbol table */
+    p = validate_varint(p, end, &sym_count);
+    if (sym_count > (uint64)(end - p))
+        SEXP_VALIDATE_ERROR("unreasonable symbol count");
+    if (SEXP_VERSION_HAS_DICT(data[0]))
+    {
+        /*
+         * Dictionary symbol table: entries are varint IDs. Only structural
+         * validity is checked here; resolution against pg_sexp_dictionary
+         * happens at read time.
+         */
+        for (i = 0; i < sym_count; i++)
+        {
+            uint64 id;
+
+            p = validate_varint(p, end, &id);
+            if (id > PG_INT32_MAX)
+                SEXP_VALIDATE_ERROR("dictionary symbol id out of range");
+        }
+    }
+    else
+    {
+        for (i = 0; i < sym_count; i++)
+        {
+            uint64 slen;
+
+            p = validate_varint(p, end, &slen);
+            if (slen > (uint64)(end - p))
+                SEXP_VALIDATE_ERROR("truncated symbol table");
+            p += slen;
+        }
+    }
+
+    /* Root element, which must consume the remaining bytes exactly */
+    p = validate_element(p, end, sym_count, 0);
+    if (p != end)
+        SEXP_VALIDATE_ERROR("trailing bytes after root element");
+}
@@ -0,0 +1,577 @@
+/*
+ * sexp_jsonb.c
+ *
+ * Direct binary-to-binary conversion between sexp and jsonb.
+ *
+ * Mirroring sexp data into jsonb for downstream tools previously meant
+ * sexp_out, a trip through application code, and a full JSON parse - two
+ * text serializations for data that lives in tree encodings on both ends.
+ * The functions here walk one binary format and emit the other inside the
+ * backend, with no intermediate text:
+ *
+ *   sexp_to_jsonb(sexp)   - lists become arrays; integers and floats become
+ *                           numerics; strings and symbols become JSON
+ *                           strings; nil becomes the empty array
+ *   jsonb_to_sexp(jsonb)  - arrays become lists; objects become lists of
+ *                           (key value) pairs with string keys; true/false
+ *                           become symbols; null becomes nil; numbers
+ *                           become integers when they have no fractional
+ *                           part and fit in int64, floats otherwise
+ *
+ * The mapping is lossy in both directions (symbols and strings collapse,
+ * objects have no native sexp form), which matches what the text round-trip
+ * produced anyway. jsonb_to_sexp assembles output exactly like the parser,
+ * so converted values carry valid SEntry tables, hashes and Bloom metadata.
+ */
+
+#include "pg_sexp.h"
+#include "sexp_debug.h"
+#include "utils/fmgrprotos.h"
+#include "utils/jsonb.h"
+#include "utils/numeric.h"
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * SEntry type class for an element's leading byte. (Private duplicate of
+ * the parser's mapping, like the other emit-side translation units keep.)
+ */
+static uint32
+get_sentry_type_from_tag(uint8 tag_byte)
+{
+    uint8 tag = tag_byte & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+            return SENTRY_TYPE_NIL;
+        case SEXP_TAG_SMALLINT:
+        case SEXP_TAG_INTEGER:
+            return SENTRY_TYPE_INTEGER;
+        case SEXP_TAG_FLOAT:
+            return SENTRY_TYPE_FLOAT;
+        case SEXP_TAG_SYMBOL_REF:
+            return SENTRY_TYPE_SYMBOL;
+        case SEXP_TAG_SHORT_STRING:
+        case SEXP_TAG_LONG_STRING:
+            return SENTRY_TYPE_STRING;
+        case SEXP_TAG_LIST:
+            return SENTRY_TYPE_LIST;
+        default:
+            return SENTRY_TYPE_NIL;
+    }
+}
+
+/*
+ * Append a varint to a StringInfo buffer.
+ */
+static void
+write_varint_to_buf(StringInfo buf, uint64 value)
+{
+    uint8 tmp[10];
+    int len = encode_varint(tmp, value);
+    appendBinaryStringInfo(buf, (char *)tmp, len);
+}
+
+/* ----------------------------------------------------------------
+ * sexp -> jsonb
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * Convert the element at state->ptr into jsonb values pushed through
+ * pstate. Scalars are pushed with the given sequence token (WJB_ELEM
+ * inside arrays); lists open their own array. Returns the result of the
+ * last pushJsonbValue call, which is the finished tree once the outermost
+ * container closes.
+ */
+static JsonbValue *
+sexp_element_to_jsonb(SexpReadState *state, JsonbParseState **pstate,
+                      JsonbIteratorToken seq, int depth)
+{
+    JsonbValue jv;
+    uint8 byte;
+    uint8 tag;
+
+    SEXP_CHECK_DEPTH(depth);
+
+    if (state->ptr >= state->end)
+    {
+        /* Treat truncation like the text emitter: an empty list */
+        pushJsonbValue(pstate, WJB_BEGIN_ARRAY, NULL);
+        return pushJsonbValue(pstate, WJB_END_ARRAY, NULL);
+    }
+
+    byte = *state->ptr++;
+    tag = byte & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+            pushJsonbValue(pstate, WJB_BEGIN_ARRAY, NULL);
+            return pushJsonbValue(pstate, WJB_END_ARRAY, NULL);
+
+        case SEXP_TAG_SMALLINT:
+        {
+            int val = (int)(byte & SEXP_DATA_MASK) - SEXP_SMALLINT_BIAS;
+
+            jv.type = jbvNumeric;
+            jv.val.numeric = DatumGetNumeric(
+                DirectFunctionCall1(int8_numeric, Int64GetDatum((int64) val)));
+            return pushJsonbValue(pstate, seq, &jv);
+        }
+
+        case SEXP_TAG_INTEGER:
+        {
+            uint64 encoded = decode_varint(&state->ptr, state->end);
+            int64 val = zigzag_decode(encoded);
+
+            jv.type = jbvNumeric;
+            jv.val.numeric = DatumGetNumeric(
+                DirectFunctionCall1(int8_numeric, Int64GetDatum(val)));
+            return pushJsonbValue(pstate, seq, &jv);
+        }
+
+        case SEXP_TAG_FLOAT:
+        {
+            float8 val;
+
+            memcpy(&val, state->ptr, sizeof(float8));
+            state->ptr += sizeof(float8);
+
+            /*
+             * jsonb numerics cannot hold NaN or infinity; use the same
+             * string spellings to_jsonb picks for float8.
+             */
+            if (isnan(val) || isinf(val))
+            {
+                const char *s = isnan(val) ? "NaN"
+                              : (val > 0 ? "Infinity" : "-Infinity");
+
+                jv.type = jbvString;
+                jv.val.string.val = (char *) s;
+                jv.val.string.len = strlen(s);
+            }
+            else
+            {
+                jv.type = jbvNumeric;
+                jv.val.numeric = DatumGetNumeric(
+                    DirectFunctionCall1(float8_numeric, Float8GetDatum(val)));
+            }
+            return pushJsonbValue(pstate, seq, &jv);
+        }
+
+        case SEXP_TAG_SYMBOL_REF:
+        {
+            uint64 idx = decode_varint(&state->ptr, state->end);
+
+            if ((int) idx >= state->sym_count)
+                ereport(ERROR,
+                        (errcode(ERRCODE_DATA_CORRUPTED),
+                         errmsg("invalid symbol reference in sexp binary data")));
+
+            jv.type = jbvString;
+            jv.val.string.val = state->symbols[idx];
+            jv.val.string.len = state->sym_lengths[idx];
+            return pushJsonbValue(pstate, seq, &jv);
+        }
+
+        case SEXP_TAG_SHORT_STRING:
+        case SEXP_TAG_LONG_STRING:
+        {
+            uint64 slen;
+
+            if (tag == SEXP_TAG_SHORT_STRING)
+                slen = byte & SEXP_DATA_MASK;
+            else
+                slen = decode_varint(&state->ptr, state->end);
+            if (slen > (uint64) (state->end - state->ptr))
+                slen = state->end - state->ptr;
+
+            jv.type = jbvString;
+            jv.val.string.val = (char *) state->ptr;
+            jv.val.string.len = (int) slen;
+            state->ptr += slen;
+            return pushJsonbValue(pstate, seq, &jv);
+        }
+
+        case SEXP_TAG_LIST:
+        {
+            uint64 count;
+            uint64 i;
+            JsonbValue *res;
+
+            count = byte & SEXP_DATA_MASK;
+            if (unlikely(count == 0))
+            {
+                /* Large list: skip count, hash and SEntry table */
+                uint32 cnt32 = SEXP_LOAD_UINT32_UNALIGNED(state->ptr);
+
+                state->ptr += sizeof(uint32);
+                count = cnt32;
+                state->ptr += sizeof(uint32);
+                state->ptr += count * sizeof(SEntry);
+            }
+            else
+            {
+                /* Small list: skip the payload size prefix */
+                (void) decode_varint(&state->ptr, state->end);
+            }
+
+            pushJsonbValue(pstate, WJB_BEGIN_ARRAY, NULL);
+            for (i = 0; i < count; i++)
+                sexp_element_to_jsonb(state, pstate, WJB_ELEM, depth + 1);
+            res = pushJsonbValue(pstate, WJB_END_ARRAY, NULL);
+            return res;
+        }
+
+        default:
+            ereport(ERROR,
+                    (errcode(ERRCODE_DATA_CORRUPTED),
+                     errmsg("invalid sexp tag: %d", tag)));
+            return NULL;        /* keep compiler quiet */
+    }
+}
+
+/*
+ * sexp_to_jsonb(sexp) - convert to jsonb without producing text.
+ */
+PG_FUNCTION_INFO_V1(sexp_to_jsonb);
+Datum
+sexp_to_jsonb(PG_FUNCTION_ARGS)
+{
+    Sexp *sexp = PG_GETARG_SEXP(0);
+    SexpReadState state;
+    JsonbParseState *pstate = NULL;
+    JsonbValue *res;
+    uint8 tag;
+
+    sexp_init_read_state(&state, sexp);
+
+    tag = (state.ptr < state.end) ? (*state.ptr & SEXP_TAG_MASK) : SEXP_TAG_NIL;
+    if (tag == SEXP_TAG_LIST || tag == SEXP_TAG_NIL)
+        res = sexp_element_to_jsonb(&state, &pstate, WJB_ELEM, 0);
+    else
+    {
+        /* Scalar root: jsonb requires the raw-scalar pseudo array */
+        JsonbValue va;
+
+        va.type = jbvArray;
+        va.val.array.rawScalar = true;
+        va.val.array.nElems = 1;
+        pushJsonbValue(&pstate, WJB_BEGIN_ARRAY, &va);
+        sexp_element_to_jsonb(&state, &pstate, WJB_ELEM, 0);
+        res = pushJsonbValue(&pstate, WJB_END_ARRAY, NULL);
+    }
+
+    sexp_free_read_state(&state);
+
+    PG_RETURN_JSONB_P(JsonbValueToJsonb(res));
+}
+
+/* ----------------------------------------------------------------
+ * jsonb -> sexp
+ * ----------------------------------------------------------------
+ */
+
+/*
+ * Wrap already-encoded child elements in a list, mirroring the parser's
+ * small/large split. Returns the list's structural hash.
+ */
+static uint32
+wrap_children_in_list(StringInfo out, StringInfo children, SEntry *sentries,
+                      uint32 *child_hashes, int count)
+{
+    uint32 list_hash;
+    int i;
+
+    if (count == 0)
+    {
+        appendStringInfoChar(out, SEXP_TAG_NIL);
+        return 0;
+    }
+
+    /* Same list hash formula as the parser */
+    list_hash = sexp_hash_uint32((uint32) count);
+    list_hash = hash_combine(list_hash, sexp_hash_uint32(SEXP_TAG_LIST));
+    for (i = 0; i < count; i++)
+        list_hash = sexp_hash_combine(list_hash, child_hashes[i], i);
+
+    if (count <= SEXP_SMALL_LIST_MAX)
+    {
+        appendStringInfoChar(out, SEXP_TAG_LIST | (uint8) count);
+        write_varint_to_buf(out, (uint64) children->len);
+        appendBinaryStringInfo(out, children->data, children->len);
+    }
+    else
+    {
+        uint32 cnt32 = (uint32) count;
+
+        appendStringInfoChar(out, SEXP_TAG_LIST);
+        appendBinaryStringInfo(out, (char *) &cnt32, sizeof(uint32));
+        appendBinaryStringInfo(out, (char *) &list_hash, sizeof(uint32));
+        appendBinaryStringInfo(out, (char *) sentries, count * sizeof(SEntry));
+        appendBinaryStringInfo(out, children->data, children->len);
+    }
+
+    return list_hash;
+}
+
+/*
+ * Emit a string element; returns its structural hash.
+ */
+static uint32
+emit_string_element(StringInfo out, const char *data, int len)
+{
+    if (len <= SEXP_SHORT_STRING_MAX)
+    {
+        appendStringInfoChar(out, SEXP_TAG_SHORT_STRING | (uint8) len);
+        appendBinaryStringInfo(out, data, len);
+    }
+    else
+    {
+        appendStringInfoChar(out, SEXP_TAG_LONG_STRING);
+        write_varint_to_buf(out, (uint64) len);
+        appendBinaryStringInfo(out, data, len);
+    }
+    return sexp_hash_string_with_tag(SEXP_TAG_SHORT_STRING, data, len);
+}
+
+/*
+ * Emit a jsonb numeric. Values with no fractional part that fit in int64
+ * become integer elements (smallint form when possible); everything else
+ * becomes a float. Classification runs on numeric_out's text, which is the
+ * only numeric entry point that does not round through float8 first.
+ */
+static uint32
+emit_numeric_element(StringInfo out, Numeric num)
+{
+    char *str = DatumGetCString(DirectFunctionCall1(numeric_out,
+                                                    NumericGetDatum(num)));
+    bool integral = true;
+    char *p;
+    uint32 hash;
+
+    for (p = str; *p; p++)
+    {
+        if (*p == '.' || *p == 'e' || *p == 'E' || *p == 'N' || *p == 'I')
+        {
+            integral = false;
+            break;
+        }
+    }
+
+    if (integral)
+    {
+        int64 val;
+
+        errno = 0;
+        val = strtoll(str, &p, 10);
+        if (errno == 0 && *p == '\0')
+        {
+            pfree(str);
+            if (val >= SEXP_SMALLINT_MIN && val <= SEXP_SMALLINT_MAX)
+                appendStringInfoChar(out, SEXP_TAG_SMALLINT |
+                                     (uint8)((int) val + SEXP_SMALLINT_BIAS));
+            else
+            {
+                appendStringInfoChar(out, SEXP_TAG_INTEGER);
+                write_varint_to_buf(out, zigzag_encode(val));
+            }
+            return hash_combine(sexp_hash_uint32(SEXP_TAG_INTEGER),
+                                sexp_hash_int64(val));
+        }
+        /* Out of int64 range: fall through to the float form */
+    }
+    pfree(str);
+
+    {
+        float8 val = DatumGetFloat8(DirectFunctionCall1(numeric_float8,
+                                                        NumericGetDatum(num)));
+
+        appendStringInfoChar(out, SEXP_TAG_FLOAT);
+        appendBinaryStringInfo(out, (char *) &val, sizeof(float8));
+        hash = hash_combine(sexp_hash_uint32(SEXP_TAG_FLOAT),
+                            sexp_hash_float64(val));
+    }
+    return hash;
+}
+
+/*
+ * Emit one jsonb value (already fetched as tok/val) as a sexp element.
+ * Containers consume their matching END token from the iterator. Returns
+ * the element's structural hash.
+ */
+static uint32
+jsonb_value_to_element(JsonbIterator **it, JsonbIteratorToken tok,
+                       JsonbValue *val, StringInfo out,
+                       SexpSymbolTable *symtab, int depth)
+{
+    SEXP_CHECK_DEPTH(depth);
+
+    if (tok == WJB_BEGIN_ARRAY)
+    {
+        int nelems = val->val.array.nElems;
+        StringInfoData children;
+        SEntry *sentries;
+        uint32 *child_hashes;
+        JsonbValue child;
+        int count = 0;
+        uint32 hash;
+
+        initStringInfo(&children);
+        sentries = palloc(sizeof(SEntry) * Max(nelems, 1));
+        child_hashes = palloc(sizeof(uint32) * Max(nelems, 1));
+
+        while ((tok = JsonbIteratorNext(it, &child, false)) != WJB_END_ARRAY)
+        {
+            int elem_start = children.len;
+
+            child_hashes[count] = jsonb_value_to_element(it, tok, &child,
+                                                         &children, symtab,
+                                                         depth + 1);
+            sentries[count] = SENTRY_MAKE(
+                get_sentry_type_from_tag((uint8) children.data[elem_start]),
+                elem_start);
+            count++;
+        }
+
+        hash = wrap_children_in_list(out, &children, sentries,
+                                     child_hashes, count);
+        pfree(children.data);
+        pfree(sentries);
+        pfree(child_hashes);
+        return hash;
+    }
+
+    if (tok == WJB_BEGIN_OBJECT)
+    {
+        int npairs = val->val.object.nPairs;
+        StringInfoData pairs;
+        StringInfoData pair;
+        SEntry *sentries;
+        uint32 *pair_hashes;
+        JsonbValue key;
+        int count = 0;
+        uint32 hash;
+
+        initStringInfo(&pairs);
+        initStringInfo(&pair);
+        sentries = palloc(sizeof(SEntry) * Max(npairs, 1));
+        pair_hashes = palloc(sizeof(uint32) * Max(npairs, 1));
+
+        while ((tok = JsonbIteratorNext(it, &key, false)) != WJB_END_OBJECT)
+        {
+            JsonbValue child;
+            SEntry pair_sentries[2];
+            uint32 pair_child_hashes[2];
+            int pair_start = pairs.len;
+
+            Assert(tok == WJB_KEY);
+
+            /* Each pair becomes a two-element (key value) list */
+            resetStringInfo(&pair);
+            pair_child_hashes[0] = emit_string_element(&pair,
+                                                       key.val.string.val,
+                                                       key.val.string.len);
+            pair_sentries[0] = SENTRY_MAKE(
+                get_sentry_type_from_tag((uint8) pair.data[0]), 0);
+
+            tok = JsonbIteratorNext(it, &child, false);
+            {
+                int value_start = pair.len;
+
+                pair_child_hashes[1] = jsonb_value_to_element(it, tok, &child,
+                                                              &pair, symtab,
+                                                              depth + 1);
+                pair_sentries[1] = SENTRY_MAKE(
+                    get_sentry_type_from_tag((uint8) pair.data[value_start]),
+                    value_start);
+            }
+
+            pair_hashes[count] = wrap_children_in_list(&pairs, &pair,
+                                                       pair_sentries,
+                                                       pair_child_hashes, 2);
+            sentries[count] = SENTRY_MAKE(SENTRY_TYPE_LIST, pair_start);
+            count++;
+        }
+
+        hash = wrap_children_in_list(out, &pairs, sentries, pair_hashes, count);
+        pfree(pairs.data);
+        pfree(pair.data);
+        pfree(sentries);
+        pfree(pair_hashes);
+        return hash;
+    }
+
+    /* Scalar (WJB_ELEM or WJB_VALUE) */
+    switch (val->type)
+    {
+        case jbvNull:
+            appendStringInfoChar(out, SEXP_TAG_NIL);
+            return 0;
+
+        case jbvBool:
+        {
+            const char *sym = val->val.boolean ? "true" : "false";
+            int len = strlen(sym);
+            int sym_idx = sexp_symtab_intern(symtab, sym, len);
+
+            appendStringInfoChar(out, SEXP_TAG_SYMBOL_REF);
+            write_varint_to_buf(out, sym_idx);
+            return sexp_hash_string_with_tag(SEXP_TAG_SYMBOL_REF, sym, len);
+        }
+
+        case jbvNumeric:
+            return emit_numeric_element(out, val->val.numeric);
+
+        case jbvString:
+            return emit_string_element(out, val->val.string.val,
+                                       val->val.string.len);
+
+        default:
+            elog(ERROR, "unexpected jsonb value type: %d", (int) val->type);
+            return 0;           /* keep compiler quiet */
+    }
+}
+
+/*
+ * jsonb_to_sexp(jsonb) - convert from jsonb without producing text.
+ */
+PG_FUNCTION_INFO_V1(jsonb_to_sexp);
+Datum
+jsonb_to_sexp(PG_FUNCTION_ARGS)
+{
+    Jsonb *jb = PG_GETARG_JSONB_P(0);
+    JsonbIterator *it;
+    JsonbIteratorToken tok;
+    JsonbValue v;
+    StringInfoData element_buf;
+    SexpSymbolTable symtab;
+    Sexp *result;
+
+    sexp_symtab_init(&symtab);
+    initStringInfo(&element_buf);
+
+    it = JsonbIteratorInit(&jb->root);
+    tok = JsonbIteratorNext(&it, &v, false);
+
+    if (tok == WJB_BEGIN_ARRAY && v.val.array.rawScalar)
+    {
+        /* Scalar root: unwrap the raw-scalar pseudo array */
+        tok = JsonbIteratorNext(&it, &v, false);
+        jsonb_value_to_element(&it, tok, &v, &element_buf, &symtab, 0);
+        (void) JsonbIteratorNext(&it, &v, false);
+    }
+    else
+        jsonb_value_to_element(&it, tok, &v, &element_buf, &symtab, 0);
+
+    result = sexp_build_result(&element_buf, &symtab);
+
+    sexp_symtab_free(&symtab);
+    pfree(element_buf.data);
+
+    PG_RETURN_SEXP(result);
+}
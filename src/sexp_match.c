@@ -80,6 +80,21 @@ is_pattern_symbol(const char *sym, int len, PatternType *type, char *capture_nam
     return false;
 }
 
+/*
+ * sexp_symbol_is_pattern - Does this symbol text denote a pattern element?
+ *
+ * Exported for GIN query-key extraction, which must skip wildcards and
+ * captures when pulling literal anchors out of a pattern.
+ */
+bool
+sexp_symbol_is_pattern(const char *sym, int len)
+{
+    PatternType type;
+    char capture_name[64];
+
+    return is_pattern_symbol(sym, len, &type, capture_name);
+}
+
 /*
  * Skip element - local version to avoid dependency issues
  */
@@ -159,45 +174,62 @@ extract_current_element(SexpReadState *state, Sexp *parent)
     uint8 *elem_start = state->ptr;
     uint8 *elem_end;
     Sexp *result;
-    int header_size;
+    int symtab_size;
     int elem_size;
     int total_size;
     uint8 *parent_data;
+    uint8 *symtab_start;
     uint8 *ptr;
     uint64 sym_count;
     int i;
-    
+
     /* Measure element size */
     skip_element_internal(state);
     elem_end = state->ptr;
-    
+
     /* Reset pointer */
     state->ptr = elem_start;
     skip_element_internal(state);
-    
-    /* Calculate header size from parent */
+
+    /* Find parent's symbol table (after version byte and any v7 metadata) */
     parent_data = (uint8 *)&parent->version;
     ptr = parent_data + 1;
+    if (SEXP_VERSION_HAS_ROOT_META(parent->version))
+        ptr += SEXP_ROOT_META_SIZE_V(parent->version);
+    symtab_start = ptr;
     sym_count = decode_varint(&ptr, parent_data + VARSIZE(parent) - VARHDRSZ);
-    for (i = 0; i < (int)sym_count; i++)
+    if (SEXP_VERSION_HAS_DICT(parent->version))
     {
-        uint64 slen = decode_varint(&ptr, parent_data + VARSIZE(parent) - VARHDRSZ);
-        ptr += slen;
+        /* Dictionary symbol table: entries are bare varint IDs */
+        for (i = 0; i < (int)sym_count; i++)
+            (void)decode_varint(&ptr, parent_data + VARSIZE(parent) - VARHDRSZ);
     }
-    header_size = (int)(ptr - parent_data);
+    else
+    {
+        for (i = 0; i < (int)sym_count; i++)
+        {
+            uint64 slen = decode_varint(&ptr, parent_data + VARSIZE(parent) - VARHDRSZ);
+            ptr += slen;
+        }
+    }
+    symtab_size = (int)(ptr - symtab_start);
     elem_size = (int)(elem_end - elem_start);
-    
+
     /* Allocate result */
-    total_size = VARHDRSZ + header_size + elem_size;
+    total_size = VARHDRSZ + 1 + symtab_size + elem_size;
     result = (Sexp *) palloc(total_size);
     SET_VARSIZE(result, total_size);
-    
-    /* Copy header from parent */
-    memcpy(&result->version, parent_data, header_size);
-    
-    /* Copy element data */
-    memcpy(((uint8 *)&result->version) + header_size, elem_start, elem_size);
-    
+
+    /*
+     * Extracted values are emitted as v6 - no root metadata to recompute.
+     * The symbol table is copied verbatim, so the dictionary flag travels
+     * with it when the parent used dictionary encoding.
+     */
+    result->version = SEXP_FORMAT_VERSION_V6 |
+        (parent->version & SEXP_FLAG_DICT_SYMTAB);
+    memcpy(result->data, symtab_start, symtab_size);
+    memcpy(result->data + symtab_size, elem_start, elem_size);
+
     return result;
 }
 
@@ -661,14 +693,749 @@ sexp_find_first(Sexp *expr, Sexp *pattern)
     
     sexp_init_read_state(&expr_state, expr);
     sexp_init_read_state(&pat_state, pattern);
-    
+
     /* Save the starting position of the pattern element */
     pat_start = pat_state.ptr;
-    
+
     find_pattern_recursive(&expr_state, expr, &pat_state, pat_start, &found);
-    
+
     sexp_free_read_state(&expr_state);
     sexp_free_read_state(&pat_state);
-    
+
     return found;
 }
+
+/* Growable accumulator for sexp_find_all_collect */
+typedef struct FindAllAcc
+{
+    Sexp      **items;
+    int         count;
+    int         capacity;
+    int         max_results;    /* 0 = unlimited */
+    MemoryContext mcxt;         /* results and array live here */
+} FindAllAcc;
+
+/*
+ * Recursive search collecting every match, like find_pattern_recursive
+ * but without stopping at the first hit. Matched lists are still
+ * descended into, since matches can nest on deeply structured documents.
+ */
+static void
+find_all_recursive(SexpReadState *expr_state, Sexp *expr_parent,
+                   SexpReadState *pat_state, uint8 *pat_start,
+                   FindAllAcc *acc)
+{
+    uint8 byte;
+    uint8 tag;
+    uint8 *start_ptr;
+
+    if (expr_state->ptr >= expr_state->end)
+        return;
+
+    if (acc->max_results > 0 && acc->count >= acc->max_results)
+        return;
+
+    start_ptr = expr_state->ptr;
+
+    /* Try matching at current position */
+    pat_state->ptr = pat_start;
+    {
+        SexpReadState expr_copy;
+
+        expr_copy = *expr_state;
+        expr_copy.ptr = start_ptr;
+
+        if (elements_match(&expr_copy, pat_state, NULL))
+        {
+            MemoryContext oldcxt = MemoryContextSwitchTo(acc->mcxt);
+            SexpReadState extract_state;
+
+            if (acc->count >= acc->capacity)
+            {
+                acc->capacity *= 2;
+                acc->items = (Sexp **)
+                    repalloc(acc->items, acc->capacity * sizeof(Sexp *));
+            }
+
+            extract_state = *expr_state;
+            extract_state.ptr = start_ptr;
+            acc->items[acc->count++] =
+                extract_current_element(&extract_state, expr_parent);
+
+            MemoryContextSwitchTo(oldcxt);
+
+            if (acc->max_results > 0 && acc->count >= acc->max_results)
+                return;
+        }
+    }
+
+    /* Descend into lists; matches can occur inside matched subtrees too */
+    byte = *expr_state->ptr++;
+    tag = byte & SEXP_TAG_MASK;
+
+    if (tag == SEXP_TAG_LIST)
+    {
+        uint64 count;
+        uint64 i;
+
+        count = byte & SEXP_DATA_MASK;
+        if (unlikely(count == 0))
+        {
+            uint32 cnt32 = SEXP_LOAD_UINT32_UNALIGNED(expr_state->ptr);
+            expr_state->ptr += sizeof(uint32);
+            count = cnt32;
+            expr_state->ptr += sizeof(uint32);          /* hash */
+            expr_state->ptr += count * sizeof(SEntry);  /* SEntry table */
+        }
+        else
+        {
+            (void)decode_varint(&expr_state->ptr, expr_state->end);
+        }
+
+        for (i = 0; i < count; i++)
+            find_all_recursive(expr_state, expr_parent, pat_state, pat_start, acc);
+    }
+    else
+    {
+        /* Skip this non-list element */
+        expr_state->ptr = start_ptr;
+        skip_element_internal(expr_state);
+    }
+}
+
+/*
+ * sexp_find_all_collect - Collect all subexpressions matching pattern
+ *
+ * Performs one recursive traversal of expr, reusing the saved-position
+ * machinery of sexp_find_first. The result array and every extracted
+ * match are allocated in mcxt (the SRF multi-call context), so they
+ * survive across per-row calls. max_results <= 0 means unlimited.
+ * Returns the number of matches via *items.
+ */
+int
+sexp_find_all_collect(Sexp *expr, Sexp *pattern, int32 max_results,
+                      MemoryContext mcxt, Sexp ***items)
+{
+    SexpReadState expr_state;
+    SexpReadState pat_state;
+    FindAllAcc acc;
+
+    acc.capacity = 8;
+    acc.count = 0;
+    acc.max_results = (max_results > 0) ? max_results : 0;
+    acc.mcxt = mcxt;
+    acc.items = (Sexp **) MemoryContextAlloc(mcxt, acc.capacity * sizeof(Sexp *));
+
+    sexp_init_read_state(&expr_state, expr);
+    sexp_init_read_state(&pat_state, pattern);
+
+    find_all_recursive(&expr_state, expr, &pat_state, pat_state.ptr, &acc);
+
+    sexp_free_read_state(&expr_state);
+    sexp_free_read_state(&pat_state);
+
+    *items = acc.items;
+    return acc.count;
+}
+
+/*
+ * ===========================================================================
+ * COMPILED PATTERNS
+ * ===========================================================================
+ *
+ * The interpreted matcher above re-decodes the pattern's symbol table and
+ * re-classifies every pattern element on each call. The compiler below
+ * walks the pattern binary once and emits a flat pre-order instruction
+ * array (see SexpPatOp in pg_sexp.h); the executor mirrors elements_match
+ * exactly but touches only the expression side per row. Symbol and string
+ * literals are copied into the compile memory context, so the compiled
+ * pattern does not reference the original pattern datum.
+ */
+
+/* Append a zeroed instruction, growing the array; returns its index */
+static int
+pat_instr_append(SexpCompiledPattern *cp, int *capacity)
+{
+    if (cp->ninstrs >= *capacity)
+    {
+        *capacity *= 2;
+        cp->instrs = (SexpPatInstr *)
+            repalloc(cp->instrs, *capacity * sizeof(SexpPatInstr));
+    }
+    memset(&cp->instrs[cp->ninstrs], 0, sizeof(SexpPatInstr));
+    return cp->ninstrs++;
+}
+
+/*
+ * Compile one pattern element (and, for lists, its children) into cp.
+ * Must be called with CurrentMemoryContext set to the compile context,
+ * since instruction storage and literal copies allocate there.
+ */
+static void
+compile_pattern_element(SexpReadState *pat, SexpCompiledPattern *cp, int *capacity)
+{
+    int idx = pat_instr_append(cp, capacity);
+    uint8 byte;
+    uint8 tag;
+
+    if (pat->ptr >= pat->end)
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED),
+                 errmsg("truncated pattern s-expression")));
+
+    byte = *pat->ptr++;
+    tag = byte & SEXP_TAG_MASK;
+
+    switch (tag)
+    {
+        case SEXP_TAG_NIL:
+            cp->instrs[idx].op = SPAT_OP_LIT_NIL;
+            break;
+
+        case SEXP_TAG_SMALLINT:
+            cp->instrs[idx].op = SPAT_OP_LIT_SMALLINT;
+            cp->instrs[idx].tag_byte = byte;
+            break;
+
+        case SEXP_TAG_INTEGER:
+            cp->instrs[idx].op = SPAT_OP_LIT_INTEGER;
+            cp->instrs[idx].uval = decode_varint(&pat->ptr, pat->end);
+            break;
+
+        case SEXP_TAG_FLOAT:
+            cp->instrs[idx].op = SPAT_OP_LIT_FLOAT;
+            memcpy(&cp->instrs[idx].fval, pat->ptr, sizeof(float8));
+            pat->ptr += sizeof(float8);
+            break;
+
+        case SEXP_TAG_SYMBOL_REF:
+        {
+            uint64 sym_idx = decode_varint(&pat->ptr, pat->end);
+            const char *sym;
+            int sym_len;
+            PatternType ptype;
+            char capture_name[64];
+
+            if ((int)sym_idx >= pat->sym_count)
+                ereport(ERROR,
+                        (errcode(ERRCODE_DATA_CORRUPTED),
+                         errmsg("invalid symbol reference in pattern")));
+
+            sym = pat->symbols[sym_idx];
+            sym_len = pat->sym_lengths[sym_idx];
+
+            if (is_pattern_symbol(sym, sym_len, &ptype, capture_name))
+            {
+                if (ptype == PAT_WILDCARD_REST || ptype == PAT_CAPTURE_REST)
+                    cp->instrs[idx].op = SPAT_OP_REST;
+                else
+                    cp->instrs[idx].op = SPAT_OP_ANY;
+            }
+            else
+            {
+                cp->instrs[idx].op = SPAT_OP_LIT_SYMBOL;
+                cp->instrs[idx].str = palloc(sym_len);
+                memcpy(cp->instrs[idx].str, sym, sym_len);
+                cp->instrs[idx].str_len = sym_len;
+            }
+            break;
+        }
+
+        case SEXP_TAG_SHORT_STRING:
+        case SEXP_TAG_LONG_STRING:
+        {
+            uint64 len;
+
+            if (tag == SEXP_TAG_SHORT_STRING)
+                len = byte & SEXP_DATA_MASK;
+            else
+                len = decode_varint(&pat->ptr, pat->end);
+
+            cp->instrs[idx].op = SPAT_OP_LIT_STRING;
+            cp->instrs[idx].pat_tag = tag;
+            cp->instrs[idx].str = palloc(len);
+            memcpy(cp->instrs[idx].str, pat->ptr, len);
+            cp->instrs[idx].str_len = (int)len;
+            pat->ptr += len;
+            break;
+        }
+
+        case SEXP_TAG_LIST:
+        {
+            uint64 count = byte & SEXP_DATA_MASK;
+            uint64 i;
+
+            if (unlikely(count == 0))
+            {
+                uint32 cnt32 = SEXP_LOAD_UINT32_UNALIGNED(pat->ptr);
+                pat->ptr += sizeof(uint32);
+                count = cnt32;
+                pat->ptr += sizeof(uint32);            /* stored hash */
+                pat->ptr += count * sizeof(SEntry);    /* SEntry table */
+            }
+            else
+            {
+                (void)decode_varint(&pat->ptr, pat->end);
+            }
+
+            cp->instrs[idx].op = SPAT_OP_LIST_BEGIN;
+            cp->instrs[idx].nelems = (uint32)count;
+
+            for (i = 0; i < count; i++)
+                compile_pattern_element(pat, cp, capacity);
+            break;
+        }
+
+        default:
+            ereport(ERROR,
+                    (errcode(ERRCODE_DATA_CORRUPTED),
+                     errmsg("invalid element tag in pattern")));
+    }
+}
+
+/*
+ * sexp_pattern_compile - Compile a pattern into an instruction array
+ *
+ * The compiled pattern and all literal copies are allocated in mcxt
+ * (typically flinfo->fn_mcxt so the plan survives across rows).
+ */
+SexpCompiledPattern *
+sexp_pattern_compile(Sexp *pattern, MemoryContext mcxt)
+{
+    MemoryContext oldcxt = MemoryContextSwitchTo(mcxt);
+    SexpCompiledPattern *cp = palloc0(sizeof(SexpCompiledPattern));
+    SexpReadState pat_state;
+    int capacity = 8;
+
+    cp->instrs = palloc(capacity * sizeof(SexpPatInstr));
+    cp->ninstrs = 0;
+
+    sexp_init_read_state(&pat_state, pattern);
+    compile_pattern_element(&pat_state, cp, &capacity);
+    sexp_free_read_state(&pat_state);
+
+    MemoryContextSwitchTo(oldcxt);
+    return cp;
+}
+
+/*
+ * Execute one instruction against the expression element at expr_state->ptr.
+ * Mirrors elements_match: advances the expression state past the matched
+ * element on success; on failure the overall match is abandoned, so
+ * neither *ip nor the expression position needs restoring.
+ */
+static bool
+exec_match_element(SexpReadState *expr_state, SexpCompiledPattern *cp, int *ip)
+{
+    const SexpPatInstr *ins;
+    uint8 expr_byte;
+    uint8 expr_tag;
+
+    if (*ip >= cp->ninstrs)
+        return false;
+    ins = &cp->instrs[(*ip)++];
+
+    if (expr_state->ptr >= expr_state->end)
+        return false;
+
+    if (ins->op == SPAT_OP_ANY)
+    {
+        skip_element_internal(expr_state);
+        return true;
+    }
+
+    if (ins->op == SPAT_OP_REST)
+    {
+        /* Rest patterns are only valid as the last element of a list */
+        return false;
+    }
+
+    expr_byte = *expr_state->ptr++;
+    expr_tag = expr_byte & SEXP_TAG_MASK;
+
+    switch (ins->op)
+    {
+        case SPAT_OP_LIT_NIL:
+            return expr_tag == SEXP_TAG_NIL;
+
+        case SPAT_OP_LIT_SMALLINT:
+            return expr_byte == ins->tag_byte;
+
+        case SPAT_OP_LIT_INTEGER:
+        {
+            uint64 val;
+
+            if (expr_tag != SEXP_TAG_INTEGER)
+                return false;
+            val = decode_varint(&expr_state->ptr, expr_state->end);
+            return val == ins->uval;
+        }
+
+        case SPAT_OP_LIT_FLOAT:
+        {
+            float8 val;
+
+            if (expr_tag != SEXP_TAG_FLOAT)
+                return false;
+            memcpy(&val, expr_state->ptr, sizeof(float8));
+            expr_state->ptr += sizeof(float8);
+            return val == ins->fval;
+        }
+
+        case SPAT_OP_LIT_SYMBOL:
+        {
+            uint64 sym_idx;
+
+            if (expr_tag != SEXP_TAG_SYMBOL_REF)
+                return false;
+            sym_idx = decode_varint(&expr_state->ptr, expr_state->end);
+            if ((int)sym_idx >= expr_state->sym_count)
+                return false;
+            return expr_state->sym_lengths[sym_idx] == ins->str_len &&
+                   memcmp(expr_state->symbols[sym_idx], ins->str,
+                          ins->str_len) == 0;
+        }
+
+        case SPAT_OP_LIT_STRING:
+        {
+            uint64 len;
+            bool match;
+
+            /* Encodings are canonical, so the tag must match too */
+            if (expr_tag != ins->pat_tag)
+                return false;
+
+            if (expr_tag == SEXP_TAG_SHORT_STRING)
+                len = expr_byte & SEXP_DATA_MASK;
+            else
+                len = decode_varint(&expr_state->ptr, expr_state->end);
+
+            match = ((int)len == ins->str_len &&
+                     memcmp(expr_state->ptr, ins->str, len) == 0);
+            expr_state->ptr += len;
+            return match;
+        }
+
+        case SPAT_OP_LIST_BEGIN:
+        {
+            uint64 expr_count;
+            uint64 expr_i;
+            uint32 k;
+
+            if (expr_tag != SEXP_TAG_LIST)
+                return false;
+
+            expr_count = expr_byte & SEXP_DATA_MASK;
+            if (unlikely(expr_count == 0))
+            {
+                uint32 cnt32 = SEXP_LOAD_UINT32_UNALIGNED(expr_state->ptr);
+                expr_state->ptr += sizeof(uint32);
+                expr_count = cnt32;
+                expr_state->ptr += sizeof(uint32);              /* hash */
+                expr_state->ptr += expr_count * sizeof(SEntry); /* SEntries */
+            }
+            else
+            {
+                (void)decode_varint(&expr_state->ptr, expr_state->end);
+            }
+
+            expr_i = 0;
+            for (k = 0; k < ins->nelems; k++)
+            {
+                if (cp->instrs[*ip].op == SPAT_OP_REST)
+                {
+                    (*ip)++;
+                    /* Rest pattern must be last in the pattern list */
+                    if (k + 1 != ins->nelems)
+                        return false;
+
+                    while (expr_i < expr_count)
+                    {
+                        skip_element_internal(expr_state);
+                        expr_i++;
+                    }
+                    return true;
+                }
+
+                if (expr_i >= expr_count)
+                    return false;
+
+                if (!exec_match_element(expr_state, cp, ip))
+                    return false;
+                expr_i++;
+            }
+
+            return expr_i == expr_count;
+        }
+
+        default:
+            return false;
+    }
+}
+
+/*
+ * sexp_match_compiled - Match an expression against a compiled pattern
+ *
+ * Per-row work is the expression-side traversal only; the pattern is
+ * never decoded again.
+ */
+bool
+sexp_match_compiled(Sexp *expr, SexpCompiledPattern *pattern)
+{
+    SexpReadState expr_state;
+    int ip = 0;
+    bool result;
+
+    sexp_init_read_state(&expr_state, expr);
+    result = exec_match_element(&expr_state, pattern, &ip);
+    sexp_free_read_state(&expr_state);
+
+    return result;
+}
+
+/*
+ * ===========================================================================
+ * MULTI-PATTERN SETS
+ * ===========================================================================
+ *
+ * Classification workloads run dozens of patterns against every row, and
+ * with per-pattern calls the cost is patterns x document reads. The set
+ * compiler below groups patterns by their literal head symbol - in typical
+ * rule sets most patterns look like (event-type ...) - into a small hash
+ * dispatch table. Per document we decode the head symbol once (its hash is
+ * already precomputed in the read state) and run only the patterns in that
+ * bucket plus the unanchored ones, so most patterns are rejected without
+ * touching the document at all.
+ */
+
+/*
+ * Does the compiled pattern start with a list whose first element is a
+ * literal symbol? If so return that symbol as the dispatch anchor.
+ */
+static bool
+pattern_head_anchor(SexpCompiledPattern *cp, const char **sym, int *len)
+{
+    if (cp->ninstrs > 1 &&
+        cp->instrs[0].op == SPAT_OP_LIST_BEGIN &&
+        cp->instrs[0].nelems > 0 &&
+        cp->instrs[1].op == SPAT_OP_LIT_SYMBOL)
+    {
+        *sym = cp->instrs[1].str;
+        *len = cp->instrs[1].str_len;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * sexp_multi_pattern_compile - Compile a pattern array into a dispatch set
+ *
+ * All compiled patterns and the dispatch arrays live in mcxt (typically
+ * flinfo->fn_mcxt, so the set survives across rows like single compiled
+ * patterns do).
+ */
+SexpMultiPattern *
+sexp_multi_pattern_compile(Sexp **patterns, int npatterns, MemoryContext mcxt)
+{
+    MemoryContext oldcxt = MemoryContextSwitchTo(mcxt);
+    SexpMultiPattern *mp = palloc0(sizeof(SexpMultiPattern));
+    int i;
+
+    mp->npatterns = npatterns;
+    mp->patterns = palloc(sizeof(SexpCompiledPattern *) * Max(npatterns, 1));
+    mp->anchor_syms = palloc(sizeof(const char *) * Max(npatterns, 1));
+    mp->anchor_lens = palloc(sizeof(int) * Max(npatterns, 1));
+    mp->anchor_hashes = palloc(sizeof(uint32) * Max(npatterns, 1));
+    mp->chain_next = palloc(sizeof(int) * Max(npatterns, 1));
+    mp->matched = palloc(sizeof(bool) * Max(npatterns, 1));
+    mp->unanchored_head = -1;
+
+    mp->nbuckets = 16;
+    while (mp->nbuckets < npatterns * 2)
+        mp->nbuckets <<= 1;
+    mp->buckets = palloc(sizeof(int) * mp->nbuckets);
+    for (i = 0; i < mp->nbuckets; i++)
+        mp->buckets[i] = -1;
+
+    for (i = 0; i < npatterns; i++)
+    {
+        SexpCompiledPattern *cp = sexp_pattern_compile(patterns[i], mcxt);
+        const char *sym;
+        int len;
+
+        mp->patterns[i] = cp;
+
+        if (pattern_head_anchor(cp, &sym, &len))
+        {
+            /* Same hash the read state precomputes for symbols */
+            uint32 hash = hash_bytes((const unsigned char *) sym, len);
+            int b = hash & (mp->nbuckets - 1);
+
+            mp->anchor_syms[i] = sym;
+            mp->anchor_lens[i] = len;
+            mp->anchor_hashes[i] = hash;
+            mp->chain_next[i] = mp->buckets[b];
+            mp->buckets[b] = i;
+        }
+        else
+        {
+            mp->anchor_syms[i] = NULL;
+            mp->anchor_lens[i] = 0;
+            mp->anchor_hashes[i] = 0;
+            mp->chain_next[i] = mp->unanchored_head;
+            mp->unanchored_head = i;
+        }
+    }
+
+    MemoryContextSwitchTo(oldcxt);
+    return mp;
+}
+
+/*
+ * Decode the document's head symbol (root must be a list whose first
+ * element is a symbol reference). Does not advance the caller's state.
+ * Returns false when the document has no such head, in which case no
+ * anchored pattern can match it.
+ */
+static bool
+doc_head_symbol(SexpReadState *state, uint32 *hash, const char **sym, int *len)
+{
+    uint8 *p = state->ptr;
+    uint8 byte;
+    uint64 count;
+    uint64 idx;
+
+    if (p >= state->end)
+        return false;
+
+    byte = *p++;
+    if ((byte & SEXP_TAG_MASK) != SEXP_TAG_LIST)
+        return false;
+
+    count = byte & SEXP_DATA_MASK;
+    if (unlikely(count == 0))
+    {
+        uint32 cnt32 = SEXP_LOAD_UINT32_UNALIGNED(p);
+
+        p += sizeof(uint32);
+        count = cnt32;
+        p += sizeof(uint32);                /* hash */
+        p += count * sizeof(SEntry);        /* SEntry table */
+    }
+    else
+    {
+        (void)decode_varint(&p, state->end);
+    }
+
+    if (count == 0 || p >= state->end || (*p & SEXP_TAG_MASK) != SEXP_TAG_SYMBOL_REF)
+        return false;
+
+    p++;
+    idx = decode_varint(&p, state->end);
+    if ((int)idx >= state->sym_count)
+        return false;
+
+    *hash = state->sym_hashes[idx];
+    *sym = state->symbols[idx];
+    *len = state->sym_lengths[idx];
+    return true;
+}
+
+/* Run one compiled pattern from the set against the expression root */
+static bool
+run_set_pattern(SexpReadState *expr_state, uint8 *expr_start,
+                SexpMultiPattern *mp, int i)
+{
+    int ip = 0;
+
+    expr_state->ptr = expr_start;
+    return exec_match_element(expr_state, mp->patterns[i], &ip);
+}
+
+/*
+ * sexp_match_any_multi - Does any pattern in the set match?
+ *
+ * One head-symbol decode dispatches to the candidate patterns; each
+ * candidate then pays only its expression-side traversal.
+ */
+bool
+sexp_match_any_multi(Sexp *expr, SexpMultiPattern *mp)
+{
+    SexpReadState expr_state;
+    uint8 *expr_start;
+    const char *head_sym;
+    int head_len;
+    uint32 head_hash;
+    bool result = false;
+    int i;
+
+    sexp_init_read_state(&expr_state, expr);
+    expr_start = expr_state.ptr;
+
+    if (doc_head_symbol(&expr_state, &head_hash, &head_sym, &head_len))
+    {
+        for (i = mp->buckets[head_hash & (mp->nbuckets - 1)];
+             i != -1 && !result;
+             i = mp->chain_next[i])
+        {
+            if (mp->anchor_hashes[i] == head_hash &&
+                mp->anchor_lens[i] == head_len &&
+                memcmp(mp->anchor_syms[i], head_sym, head_len) == 0)
+                result = run_set_pattern(&expr_state, expr_start, mp, i);
+        }
+    }
+
+    for (i = mp->unanchored_head; i != -1 && !result; i = mp->chain_next[i])
+        result = run_set_pattern(&expr_state, expr_start, mp, i);
+
+    sexp_free_read_state(&expr_state);
+    return result;
+}
+
+/*
+ * sexp_match_which_multi - Which patterns in the set match?
+ *
+ * Fills which[] with the 1-based indices of every matching pattern, in
+ * pattern order, and returns the count. Same dispatch as match_any but
+ * every candidate runs.
+ */
+int
+sexp_match_which_multi(Sexp *expr, SexpMultiPattern *mp, int *which)
+{
+    SexpReadState expr_state;
+    uint8 *expr_start;
+    const char *head_sym;
+    int head_len;
+    uint32 head_hash;
+    int count = 0;
+    int i;
+
+    memset(mp->matched, 0, sizeof(bool) * Max(mp->npatterns, 1));
+
+    sexp_init_read_state(&expr_state, expr);
+    expr_start = expr_state.ptr;
+
+    if (doc_head_symbol(&expr_state, &head_hash, &head_sym, &head_len))
+    {
+        for (i = mp->buckets[head_hash & (mp->nbuckets - 1)];
+             i != -1;
+             i = mp->chain_next[i])
+        {
+            if (mp->anchor_hashes[i] == head_hash &&
+                mp->anchor_lens[i] == head_len &&
+                memcmp(mp->anchor_syms[i], head_sym, head_len) == 0)
+                mp->matched[i] = run_set_pattern(&expr_state, expr_start, mp, i);
+        }
+    }
+
+    for (i = mp->unanchored_head; i != -1; i = mp->chain_next[i])
+        mp->matched[i] = run_set_pattern(&expr_state, expr_start, mp, i);
+
+    sexp_free_read_state(&expr_state);
+
+    for (i = 0; i < mp->npatterns; i++)
+        if (mp->matched[i])
+            which[count++] = i + 1;
+
+    return count;
+}
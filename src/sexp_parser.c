@@ -20,21 +20,277 @@
 #include <ctype.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 /* Forward declarations */
 static void skip_whitespace(SexpParseState *state);
 static uint32 parse_list(SexpParseState *state);
 static uint32 parse_atom(SexpParseState *state);
 static uint32 parse_string(SexpParseState *state);
 static uint32 parse_number_or_symbol(SexpParseState *state);
-static int intern_symbol(SexpParseState *state, const char *sym, int len);
+
 static void write_varint(StringInfo buf, uint64 value);
 static uint32 sexp_parse_value_with_hash(SexpParseState *state);
 
+/*
+ * ============================================================================
+ * VECTORIZED SCANNING LAYER
+ * ============================================================================
+ *
+ * The parser hot loops (whitespace skipping, token scanning, string scanning)
+ * examine one byte at a time in the scalar implementation. On bulk ingestion
+ * the byte-wise character-class checks dominate the profile, so we provide
+ * SIMD variants that classify 16 (SSE2) or 32 (AVX2) bytes per iteration and
+ * locate the first "interesting" byte with a movemask + ctz.
+ *
+ * Three scanners cover the parser's needs:
+ *   - scan_whitespace_end:   first byte NOT in { ' ', \t, \n, \v, \f, \r }
+ *   - scan_token_end:        first delimiter byte (whitespace, '(' ')' '"' ';')
+ *   - scan_string_special:   first '"' or '\' (string terminator / escape)
+ *
+ * All scanners fall back to a scalar loop for the sub-register tail, and the
+ * scalar loops alone are used on non-x86 builds. Semantics are identical to
+ * the original byte-wise code: the whitespace set matches isspace() for the
+ * ASCII range the parser cares about, and comment handling (';') stays in
+ * skip_whitespace itself.
+ */
+
+/* Scalar classification helpers shared by all paths */
+static inline bool
+is_sexp_whitespace(uint8 c)
+{
+    return c == ' ' || (c >= 0x09 && c <= 0x0D);
+}
+
+static inline bool
+is_sexp_delimiter(uint8 c)
+{
+    return is_sexp_whitespace(c) || c == '(' || c == ')' || c == '"' || c == ';';
+}
+
+#if defined(__AVX2__)
+
+/*
+ * AVX2: classify 32 bytes per iteration.
+ * Whitespace test: (c == ' ') || (0x09 <= c <= 0x0D). The range test uses
+ * signed byte compares, which is safe because the range is below 0x80 and
+ * high-bit bytes (negative when signed) fail the lower-bound compare.
+ */
+static const char *
+scan_whitespace_end(const char *p, const char *end)
+{
+    const __m256i v_space = _mm256_set1_epi8(' ');
+    const __m256i v_lo = _mm256_set1_epi8(0x09 - 1);
+    const __m256i v_hi = _mm256_set1_epi8(0x0D + 1);
+
+    while (p + 32 <= end)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) p);
+        __m256i ws = _mm256_or_si256(
+            _mm256_cmpeq_epi8(v, v_space),
+            _mm256_and_si256(_mm256_cmpgt_epi8(v, v_lo),
+                             _mm256_cmpgt_epi8(v_hi, v)));
+        uint32 mask = (uint32) _mm256_movemask_epi8(ws);
+
+        if (mask != 0xFFFFFFFF)
+            return p + __builtin_ctz(~mask);
+        p += 32;
+    }
+
+    while (p < end && is_sexp_whitespace((uint8) *p))
+        p++;
+    return p;
+}
+
+static const char *
+scan_token_end(const char *p, const char *end)
+{
+    const __m256i v_space = _mm256_set1_epi8(' ');
+    const __m256i v_lo = _mm256_set1_epi8(0x09 - 1);
+    const __m256i v_hi = _mm256_set1_epi8(0x0D + 1);
+    const __m256i v_lparen = _mm256_set1_epi8('(');
+    const __m256i v_rparen = _mm256_set1_epi8(')');
+    const __m256i v_quote = _mm256_set1_epi8('"');
+    const __m256i v_semi = _mm256_set1_epi8(';');
+
+    while (p + 32 <= end)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) p);
+        __m256i delim = _mm256_or_si256(
+            _mm256_cmpeq_epi8(v, v_space),
+            _mm256_and_si256(_mm256_cmpgt_epi8(v, v_lo),
+                             _mm256_cmpgt_epi8(v_hi, v)));
+        delim = _mm256_or_si256(delim, _mm256_cmpeq_epi8(v, v_lparen));
+        delim = _mm256_or_si256(delim, _mm256_cmpeq_epi8(v, v_rparen));
+        delim = _mm256_or_si256(delim, _mm256_cmpeq_epi8(v, v_quote));
+        delim = _mm256_or_si256(delim, _mm256_cmpeq_epi8(v, v_semi));
+        {
+            uint32 mask = (uint32) _mm256_movemask_epi8(delim);
+
+            if (mask != 0)
+                return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+
+    while (p < end && !is_sexp_delimiter((uint8) *p))
+        p++;
+    return p;
+}
+
+static const char *
+scan_string_special(const char *p, const char *end)
+{
+    const __m256i v_quote = _mm256_set1_epi8('"');
+    const __m256i v_bslash = _mm256_set1_epi8('\\');
+
+    while (p + 32 <= end)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) p);
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(v, v_quote),
+                                          _mm256_cmpeq_epi8(v, v_bslash));
+        uint32 mask = (uint32) _mm256_movemask_epi8(special);
+
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+
+    while (p < end && *p != '"' && *p != '\\')
+        p++;
+    return p;
+}
+
+#elif defined(__SSE2__)
+
+/* SSE2: classify 16 bytes per iteration (baseline on all x86_64) */
+static const char *
+scan_whitespace_end(const char *p, const char *end)
+{
+    const __m128i v_space = _mm_set1_epi8(' ');
+    const __m128i v_lo = _mm_set1_epi8(0x09 - 1);
+    const __m128i v_hi = _mm_set1_epi8(0x0D + 1);
+
+    while (p + 16 <= end)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        __m128i ws = _mm_or_si128(
+            _mm_cmpeq_epi8(v, v_space),
+            _mm_and_si128(_mm_cmpgt_epi8(v, v_lo),
+                          _mm_cmplt_epi8(v, v_hi)));
+        uint32 mask = (uint32) _mm_movemask_epi8(ws);
+
+        if (mask != 0xFFFF)
+            return p + __builtin_ctz(~mask & 0xFFFF);
+        p += 16;
+    }
+
+    while (p < end && is_sexp_whitespace((uint8) *p))
+        p++;
+    return p;
+}
+
+static const char *
+scan_token_end(const char *p, const char *end)
+{
+    const __m128i v_space = _mm_set1_epi8(' ');
+    const __m128i v_lo = _mm_set1_epi8(0x09 - 1);
+    const __m128i v_hi = _mm_set1_epi8(0x0D + 1);
+    const __m128i v_lparen = _mm_set1_epi8('(');
+    const __m128i v_rparen = _mm_set1_epi8(')');
+    const __m128i v_quote = _mm_set1_epi8('"');
+    const __m128i v_semi = _mm_set1_epi8(';');
+
+    while (p + 16 <= end)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        __m128i delim = _mm_or_si128(
+            _mm_cmpeq_epi8(v, v_space),
+            _mm_and_si128(_mm_cmpgt_epi8(v, v_lo),
+                          _mm_cmplt_epi8(v, v_hi)));
+        delim = _mm_or_si128(delim, _mm_cmpeq_epi8(v, v_lparen));
+        delim = _mm_or_si128(delim, _mm_cmpeq_epi8(v, v_rparen));
+        delim = _mm_or_si128(delim, _mm_cmpeq_epi8(v, v_quote));
+        delim = _mm_or_si128(delim, _mm_cmpeq_epi8(v, v_semi));
+        {
+            uint32 mask = (uint32) _mm_movemask_epi8(delim);
+
+            if (mask != 0)
+                return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+
+    while (p < end && !is_sexp_delimiter((uint8) *p))
+        p++;
+    return p;
+}
+
+static const char *
+scan_string_special(const char *p, const char *end)
+{
+    const __m128i v_quote = _mm_set1_epi8('"');
+    const __m128i v_bslash = _mm_set1_epi8('\\');
+
+    while (p + 16 <= end)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, v_quote),
+                                       _mm_cmpeq_epi8(v, v_bslash));
+        uint32 mask = (uint32) _mm_movemask_epi8(special);
+
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+
+    while (p < end && *p != '"' && *p != '\\')
+        p++;
+    return p;
+}
+
+#else
+
+/* Scalar fallback for non-x86 builds */
+static const char *
+scan_whitespace_end(const char *p, const char *end)
+{
+    while (p < end && is_sexp_whitespace((uint8) *p))
+        p++;
+    return p;
+}
+
+static const char *
+scan_token_end(const char *p, const char *end)
+{
+    while (p < end && !is_sexp_delimiter((uint8) *p))
+        p++;
+    return p;
+}
+
+static const char *
+scan_string_special(const char *p, const char *end)
+{
+    while (p < end && *p != '"' && *p != '\\')
+        p++;
+    return p;
+}
+
+#endif /* vectorized scanning layer */
+
 /*
  * Initialize symbol table with hash table for O(1) lookup
+ *
+ * Exported (with sexp_symtab_free/sexp_symtab_intern) so other builders -
+ * notably the expanded representation - can share interned symbol tables.
  */
-static void
-init_symbol_table(SexpSymbolTable *tab)
+void
+sexp_symtab_init(SexpSymbolTable *tab)
 {
     int i;
     
@@ -55,8 +311,8 @@ init_symbol_table(SexpSymbolTable *tab)
 /*
  * Free symbol table
  */
-static void
-free_symbol_table(SexpSymbolTable *tab)
+void
+sexp_symtab_free(SexpSymbolTable *tab)
 {
     int i;
     for (i = 0; i < tab->count; i++)
@@ -115,10 +371,9 @@ grow_symbol_hash_table(SexpSymbolTable *tab)
  * Intern a symbol - returns index in symbol table
  * Uses hash table for O(1) average-case lookup instead of O(n) linear search
  */
-static int
-intern_symbol(SexpParseState *state, const char *sym, int len)
+int
+sexp_symtab_intern(SexpSymbolTable *tab, const char *sym, int len)
 {
-    SexpSymbolTable *tab = &state->symtab;
     uint32 hash = symbol_hash(sym, len);
     int slot = hash & tab->hash_mask;
     int idx;
@@ -195,20 +450,29 @@ sexp_parse(const char *input, int len)
 {
     SexpParseState state;
     StringInfoData element_buf;
-    StringInfoData final_buf;
     Sexp *result;
     int total_size;
     int i;
-    
+    int32 *dict_ids = NULL;
+
     /* Initialize parse state */
     state.input = input;
     state.ptr = input;
     state.end = input + len;
     state.depth = 0;
-    init_symbol_table(&state.symtab);
+    sexp_symtab_init(&state.symtab);
     
     /* Buffer for the root element */
     initStringInfo(&element_buf);
+
+    /*
+     * Pre-size to the input text length. The binary encoding is almost
+     * always smaller than the text form, so one up-front enlargement
+     * replaces the log2(size) doubling copies (and their latency spikes)
+     * on multi-megabyte documents. The buffer still grows normally in the
+     * rare cases where SEntry tables push the encoding past the text size.
+     */
+    enlargeStringInfo(&element_buf, len);
     state.output = &element_buf;
     
     /* Skip leading whitespace */
@@ -230,7 +494,7 @@ sexp_parse(const char *input, int len)
         /* Check for trailing garbage */
         if (state.ptr < state.end)
         {
-            free_symbol_table(&state.symtab);
+            sexp_symtab_free(&state.symtab);
             pfree(element_buf.data);
             ereport(ERROR,
                     (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
@@ -238,35 +502,123 @@ sexp_parse(const char *input, int len)
         }
     }
     
-    /* Build final output: version + symbol_table + element */
-    initStringInfo(&final_buf);
-    
-    /* Version byte */
-    appendStringInfoChar(&final_buf, SEXP_FORMAT_VERSION);
-    
-    /* Symbol table: count + entries */
-    write_varint(&final_buf, state.symtab.count);
-    for (i = 0; i < state.symtab.count; i++)
+    /*
+     * Dictionary encoding: when pg_sexp.use_symbol_dictionary is on and
+     * every symbol in this value is present in the shared dictionary, store
+     * varint dictionary IDs instead of inline symbol strings. All-or-nothing
+     * per value - a single unknown symbol falls back to the inline table.
+     */
+    if (sexp_dict_enabled && state.symtab.count > 0)
     {
-        write_varint(&final_buf, state.symtab.lengths[i]);
-        appendBinaryStringInfo(&final_buf, state.symtab.symbols[i], 
-                               state.symtab.lengths[i]);
+        dict_ids = palloc(sizeof(int32) * state.symtab.count);
+        for (i = 0; i < state.symtab.count; i++)
+        {
+            if (!sexp_dict_id_for(state.symtab.symbols[i],
+                                  state.symtab.lengths[i],
+                                  &dict_ids[i]))
+            {
+                pfree(dict_ids);
+                dict_ids = NULL;
+                break;
+            }
+        }
     }
-    
-    /* Append element data */
-    appendBinaryStringInfo(&final_buf, element_buf.data, element_buf.len);
-    
-    /* Create the result Sexp */
-    total_size = VARHDRSZ + final_buf.len;
-    result = (Sexp *) palloc(total_size);
-    SET_VARSIZE(result, total_size);
-    memcpy(&result->version, final_buf.data, final_buf.len);
-    
+
+    /*
+     * Build final output: version + root hash/Bloom + symbol_table + element.
+     *
+     * v7 root metadata: structural hash and Bloom signature of the root
+     * element. Computed once here at write time so sexp_hash, equality
+     * rejection and the containment Bloom pre-check become header reads.
+     * The signature is accumulated at maximum width while counting
+     * elements, then folded to the width the count calls for - a 64-bit
+     * filter saturates on documents beyond a few dozen elements, so big
+     * documents store 128 or 256 bits (width code in the version byte).
+     *
+     * Header and symbol table sizes are all known at this point, so the
+     * result varlena is allocated at its exact size and filled in a single
+     * pass - no intermediate staging buffer holding a second copy of the
+     * whole output.
+     */
+    {
+        uint32 root_hash;
+        SexpWideBloom root_bloom;
+        int elem_count;
+        int nwords;
+        uint8 version_byte;
+        int symtab_size;
+        uint8 *p;
+
+        bloom_wide_init(&root_bloom, SEXP_BLOOM_MAX_WORDS);
+        elem_count = sexp_element_bloom_acc((uint8 *)element_buf.data,
+                                            (uint8 *)element_buf.data + element_buf.len,
+                                            state.symtab.symbols, state.symtab.lengths,
+                                            state.symtab.count, &root_bloom);
+        nwords = bloom_words_for_count(elem_count);
+        bloom_wide_fold(&root_bloom, nwords);
+
+        /* Version byte: format version, Bloom width, dictionary flag */
+        version_byte = SEXP_FORMAT_VERSION |
+            (bloom_width_code(nwords) << SEXP_BLOOM_WIDTH_SHIFT);
+        if (dict_ids != NULL)
+            version_byte |= SEXP_FLAG_DICT_SYMTAB;
+
+        root_hash = sexp_element_hash((uint8 *)element_buf.data,
+                                      (uint8 *)element_buf.data + element_buf.len,
+                                      state.symtab.symbols, state.symtab.lengths,
+                                      state.symtab.count);
+
+        /* Symbol table size: count + entries (dictionary IDs or inline strings) */
+        symtab_size = varint_size(state.symtab.count);
+        if (dict_ids != NULL)
+        {
+            for (i = 0; i < state.symtab.count; i++)
+                symtab_size += varint_size((uint64)(uint32) dict_ids[i]);
+        }
+        else
+        {
+            for (i = 0; i < state.symtab.count; i++)
+                symtab_size += varint_size(state.symtab.lengths[i]) +
+                    state.symtab.lengths[i];
+        }
+
+        total_size = VARHDRSZ + 1 + sizeof(uint32) +
+            nwords * sizeof(uint64) + symtab_size + element_buf.len;
+        result = (Sexp *) palloc(total_size);
+        SET_VARSIZE(result, total_size);
+
+        p = &result->version;
+        *p++ = version_byte;
+        memcpy(p, &root_hash, sizeof(uint32));
+        p += sizeof(uint32);
+        memcpy(p, root_bloom.words, nwords * sizeof(uint64));
+        p += nwords * sizeof(uint64);
+
+        p += encode_varint(p, state.symtab.count);
+        if (dict_ids != NULL)
+        {
+            for (i = 0; i < state.symtab.count; i++)
+                p += encode_varint(p, (uint64)(uint32) dict_ids[i]);
+            pfree(dict_ids);
+        }
+        else
+        {
+            for (i = 0; i < state.symtab.count; i++)
+            {
+                p += encode_varint(p, state.symtab.lengths[i]);
+                memcpy(p, state.symtab.symbols[i], state.symtab.lengths[i]);
+                p += state.symtab.lengths[i];
+            }
+        }
+
+        memcpy(p, element_buf.data, element_buf.len);
+        Assert(p + element_buf.len == (uint8 *) result + total_size);
+    }
+
     /* Cleanup */
-    free_symbol_table(&state.symtab);
+    sexp_symtab_free(&state.symtab);
     pfree(element_buf.data);
-    pfree(final_buf.data);
-    
+
     return result;
 }
 
@@ -317,15 +669,15 @@ skip_whitespace(SexpParseState *state)
 {
     while (state->ptr < state->end)
     {
-        if (isspace((unsigned char) *state->ptr))
-        {
-            state->ptr++;
-        }
-        else if (*state->ptr == ';')
+        state->ptr = scan_whitespace_end(state->ptr, state->end);
+
+        if (state->ptr < state->end && *state->ptr == ';')
         {
             /* Skip line comment */
-            while (state->ptr < state->end && *state->ptr != '\n')
-                state->ptr++;
+            const char *nl = memchr(state->ptr, '\n',
+                                    state->end - state->ptr);
+
+            state->ptr = nl ? nl : state->end;
         }
         else
         {
@@ -388,11 +740,24 @@ get_sentry_type_from_tag(uint8 tag_byte)
  */
 #define PARSE_LIST_STACK_SIZE 16
 
+/*
+ * Open a gap of hsize bytes at offset pos, shifting the tail right, so a
+ * list header can be written in front of its already-emitted children.
+ */
+static void
+open_header_gap(StringInfo buf, int pos, int hsize)
+{
+    enlargeStringInfo(buf, hsize);
+    memmove(buf->data + pos + hsize, buf->data + pos, buf->len - pos);
+    buf->len += hsize;
+    buf->data[buf->len] = '\0';
+}
+
 static uint32
 parse_list(SexpParseState *state)
 {
-    StringInfoData elements;
-    StringInfo saved_output;
+    StringInfo out = state->output;
+    int list_start;
     int count = 0;
     int capacity = PARSE_LIST_STACK_SIZE;
     SEntry *sentries;
@@ -421,26 +786,30 @@ parse_list(SexpParseState *state)
     {
         state->ptr++;
         state->depth--;
-        appendStringInfoChar(state->output, SEXP_TAG_NIL);
+        appendStringInfoChar(out, SEXP_TAG_NIL);
         return 0;  /* NIL has hash 0 */
     }
-    
-    /* Parse elements into temporary buffer, tracking offsets, types, and hashes */
-    initStringInfo(&elements);
-    saved_output = state->output;
-    state->output = &elements;
-    
+
+    /*
+     * Children are emitted straight into the shared output buffer; the
+     * header is inserted over them once the count is known. This keeps one
+     * growing buffer for the whole document instead of a temporary
+     * StringInfo per nesting level, which held every subtree twice (once in
+     * the child buffer, once copied into the parent) on its way up.
+     */
+    list_start = out->len;
+
     /* Start with stack-allocated arrays */
     sentries = stack_sentries;
     child_hashes = stack_child_hashes;
-    
+
     while (state->ptr < state->end && *state->ptr != ')')
     {
-        int elem_start;
+        int elem_off;
         uint8 first_byte;
         uint32 sentry_type;
         uint32 child_hash;
-        
+
         /* Record offset before parsing element */
         if (count >= capacity)
         {
@@ -465,28 +834,25 @@ parse_list(SexpParseState *state)
             }
             capacity = new_capacity;
         }
-        elem_start = elements.len;
-        
+        elem_off = out->len - list_start;
+
         /* Parse element and get its hash */
         child_hash = sexp_parse_value_with_hash(state);
         child_hashes[count] = child_hash;
-        
+
         /* Get type from first byte of parsed element */
-        first_byte = (uint8)elements.data[elem_start];
+        first_byte = (uint8)out->data[list_start + elem_off];
         sentry_type = get_sentry_type_from_tag(first_byte);
-        
+
         /* Create SEntry: type + offset */
-        sentries[count] = SENTRY_MAKE(sentry_type, elem_start);
-        
+        sentries[count] = SENTRY_MAKE(sentry_type, elem_off);
+
         count++;
         skip_whitespace(state);
     }
-    
-    state->output = saved_output;
-    
+
     if (state->ptr >= state->end)
     {
-        pfree(elements.data);
         if (!use_stack)
         {
             pfree(sentries);
@@ -512,44 +878,54 @@ parse_list(SexpParseState *state)
     }
     
     /*
-     * Write list with SEntry table for O(1) access with no indirection.
-     * 
+     * Insert the header in front of the children with SEntry table for O(1)
+     * access with no indirection.
+     *
      * Format:
      * - Small lists (count <= SEXP_SMALL_LIST_MAX) include size prefix for O(1) skipping
      * - Large lists include SEntry table and structural hash for O(1) random access
-     * 
+     *
      * Small list format: [tag|count][varint:total_payload_size][elements...]
      * Large list format: [tag][uint32:count][uint32:hash][SEntry table][elements...]
+     *
+     * The gap memmove touches only this list's immediate children - the
+     * same bytes the old per-list buffer copied into its parent - but with
+     * no per-list allocation. SEntry offsets are relative to the element
+     * data and stay valid after the shift.
      */
-    if (count <= SEXP_SMALL_LIST_MAX)
-    {
-        /* Small list v6: tag with inline count + payload size for O(1) skip */
-        appendStringInfoChar(state->output, SEXP_TAG_LIST | (uint8)count);
-        /* Write payload size as varint - enables skip_element in O(1) */
-        write_varint(state->output, (uint64)elements.len);
-        appendBinaryStringInfo(state->output, elements.data, elements.len);
-    }
-    else
     {
-        uint32 cnt32 = (uint32)count;
-        
-        /* Large list: tag + count + hash + SEntry table + elements */
-        appendStringInfoChar(state->output, SEXP_TAG_LIST);
-        
-        /* Write count as uint32 */
-        appendBinaryStringInfo(state->output, (char *)&cnt32, sizeof(uint32));
-        
-        /* Write structural hash as uint32 */
-        appendBinaryStringInfo(state->output, (char *)&list_hash, sizeof(uint32));
-        
-        /* Write SEntry table */
-        appendBinaryStringInfo(state->output, (char *)sentries, count * sizeof(SEntry));
-        
-        /* Write element data */
-        appendBinaryStringInfo(state->output, elements.data, elements.len);
+        int payload = out->len - list_start;
+
+        if (count <= SEXP_SMALL_LIST_MAX)
+        {
+            /* Small list v6: tag with inline count + payload size for O(1) skip */
+            int hsize = 1 + varint_size((uint64) payload);
+            uint8 *h;
+
+            open_header_gap(out, list_start, hsize);
+            h = (uint8 *) out->data + list_start;
+            *h++ = SEXP_TAG_LIST | (uint8) count;
+            (void) encode_varint(h, (uint64) payload);
+        }
+        else
+        {
+            uint32 cnt32 = (uint32) count;
+
+            /* Large list: tag + count + hash + SEntry table + elements */
+            int hsize = 1 + 2 * sizeof(uint32) + count * sizeof(SEntry);
+            uint8 *h;
+
+            open_header_gap(out, list_start, hsize);
+            h = (uint8 *) out->data + list_start;
+            *h++ = SEXP_TAG_LIST;
+            memcpy(h, &cnt32, sizeof(uint32));
+            h += sizeof(uint32);
+            memcpy(h, &list_hash, sizeof(uint32));
+            h += sizeof(uint32);
+            memcpy(h, sentries, count * sizeof(SEntry));
+        }
     }
-    
-    pfree(elements.data);
+
     if (!use_stack)
     {
         pfree(sentries);
@@ -593,6 +969,17 @@ parse_string(SexpParseState *state)
     
     while (state->ptr < state->end && *state->ptr != '"')
     {
+        /* Bulk-copy the run of bytes up to the next quote or escape */
+        const char *run_end = scan_string_special(state->ptr, state->end);
+
+        if (run_end > state->ptr)
+        {
+            appendBinaryStringInfo(&str, state->ptr, run_end - state->ptr);
+            state->ptr = run_end;
+            if (state->ptr >= state->end || *state->ptr == '"')
+                break;
+        }
+
         if (*state->ptr == '\\')
         {
             state->ptr++;
@@ -625,14 +1012,11 @@ parse_string(SexpParseState *state)
                     appendStringInfoChar(&str, *state->ptr);
                     break;
             }
+            state->ptr++;
         }
-        else
-        {
-            appendStringInfoChar(&str, *state->ptr);
-        }
-        state->ptr++;
+        /* run scanner stops only at '"', '\\' or end; loop re-tests '"' */
     }
-    
+
     if (state->ptr >= state->end)
     {
         pfree(str.data);
@@ -682,19 +1066,20 @@ parse_number_or_symbol(SexpParseState *state)
     char c;
     uint32 hash;
     
-    /* Scan the token */
-    while (state->ptr < state->end && 
-           !isspace((unsigned char) *state->ptr) &&
-           *state->ptr != '(' && 
-           *state->ptr != ')' &&
-           *state->ptr != '"' &&
-           *state->ptr != ';')
+    /*
+     * Find the token boundary with the vectorized delimiter scanner, then
+     * classify the (typically short) token with a scalar pass.
+     */
+    state->ptr = scan_token_end(state->ptr, state->end);
+    end = state->ptr;
+
+    for (const char *p = start; p < end; p++)
     {
-        c = *state->ptr;
-        
+        c = *p;
+
         if (c == '-' || c == '+')
         {
-            if (state->ptr != start)
+            if (p != start)
                 is_number = false;
         }
         else if (c == '.')
@@ -711,12 +1096,8 @@ parse_number_or_symbol(SexpParseState *state)
         {
             is_number = false;
         }
-        
-        state->ptr++;
     }
     
-    end = state->ptr;
-    
     if (start == end)
     {
         ereport(ERROR,
@@ -803,7 +1184,7 @@ parse_number_or_symbol(SexpParseState *state)
     
 parse_symbol:
     {
-        int sym_idx = intern_symbol(state, start, end - start);
+        int sym_idx = sexp_symtab_intern(&state->symtab, start, end - start);
         appendStringInfoChar(state->output, SEXP_TAG_SYMBOL_REF);
         write_varint(state->output, sym_idx);
         
@@ -0,0 +1,168 @@
+/*
+ * sexp_selfuncs.c
+ *
+ * Planner selectivity estimators for the containment and pattern operators.
+ *
+ * The operators originally used contsel, which returns a flat 0.001 for
+ * every @> / @>> / @~ qual regardless of the operand. On large tables
+ * that constant picks the wrong plan shape in both directions: a query
+ * like (user (id 42) (region us-east)) that the GIN index would answer
+ * with a handful of rows is costed the same as (event _*) that matches
+ * half the table.
+ *
+ * The estimators below grade the query operand by its specificity under
+ * the GIN index: sexp_gin_query_key_count() runs the operand through the
+ * real key extraction (sexp_gin.c), so "key" means exactly what the index
+ * stores. Each key is an independent requirement on the row, so the
+ * estimate starts from a per-operator default and halves per additional
+ * key, floored well above zero because keys within one document are
+ * correlated. Column null fraction from pg_statistic scales the result.
+ *
+ * This is deliberately heuristic: a per-column key-MCV collector (custom
+ * typanalyze sampling extracted keys) could replace the per-key constant
+ * with observed frequencies later without changing the SQL surface, since
+ * the operators just name these functions in their RESTRICT clause.
+ */
+
+#include "pg_sexp.h"
+#include "catalog/pg_statistic.h"
+#include "nodes/primnodes.h"
+#include "utils/selfuncs.h"
+#include <math.h>
+
+PG_FUNCTION_INFO_V1(sexp_contains_sel);
+PG_FUNCTION_INFO_V1(sexp_contains_key_sel);
+PG_FUNCTION_INFO_V1(sexp_match_sel);
+
+/* Selectivity of a one-key containment query (order of contsel x5) */
+#define DEFAULT_SEXP_CONTAINS_SEL   0.005
+
+/* Patterns select more rows: wildcards widen what each key admits */
+#define DEFAULT_SEXP_MATCH_SEL      0.010
+
+/* An all-wildcard pattern produces no literal keys and matches broadly */
+#define DEFAULT_SEXP_WILDCARD_SEL   0.25
+
+/* Floor: keys within one document are highly correlated */
+#define MIN_SEXP_SEL                1.0e-6
+
+/*
+ * Shared estimation for all three operators.
+ */
+static double
+sexp_operator_selectivity(PlannerInfo *root, List *args, int varRelid,
+                          int strategy)
+{
+    VariableStatData vardata;
+    Node       *other;
+    bool        varonleft;
+    double      selec;
+    double      nullfrac = 0.0;
+    double      base;
+
+    base = (strategy == SEXP_GIN_MATCHES_STRATEGY) ?
+        DEFAULT_SEXP_MATCH_SEL : DEFAULT_SEXP_CONTAINS_SEL;
+
+    if (!get_restriction_variable(root, args, varRelid,
+                                  &vardata, &other, &varonleft))
+        return base;
+
+    if (HeapTupleIsValid(vardata.statsTuple))
+    {
+        Form_pg_statistic stats;
+
+        stats = (Form_pg_statistic) GETSTRUCT(vardata.statsTuple);
+        nullfrac = stats->stanullfrac;
+    }
+
+    if (other != NULL && IsA(other, Const))
+    {
+        Const      *cnst = (Const *) other;
+
+        if (cnst->constisnull)
+        {
+            /* Operators are strict: NULL operand selects nothing */
+            ReleaseVariableStats(vardata);
+            return 0.0;
+        }
+        else
+        {
+            Sexp       *query = DatumGetSexp(cnst->constvalue);
+            int         nkeys = sexp_gin_query_key_count(query, strategy);
+
+            if (nkeys <= 0)
+            {
+                /*
+                 * No literal keys. For @~ that is an all-wildcard
+                 * pattern; for containment, an atom whose key folded
+                 * away. Either way nothing narrows the match.
+                 */
+                selec = (strategy == SEXP_GIN_MATCHES_STRATEGY) ?
+                    DEFAULT_SEXP_WILDCARD_SEL : base;
+            }
+            else
+            {
+                /* Halve per key beyond the first; keys are correlated */
+                selec = base * pow(0.5, Min(nkeys - 1, 20));
+                if (selec < MIN_SEXP_SEL)
+                    selec = MIN_SEXP_SEL;
+            }
+        }
+    }
+    else
+    {
+        /* Non-constant operand: nothing to grade */
+        selec = base;
+    }
+
+    selec *= 1.0 - nullfrac;
+    CLAMP_PROBABILITY(selec);
+
+    ReleaseVariableStats(vardata);
+    return selec;
+}
+
+/*
+ * sexp_contains_sel - restriction selectivity for @> (and commuted <@)
+ */
+Datum
+sexp_contains_sel(PG_FUNCTION_ARGS)
+{
+    PlannerInfo *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+    List       *args = (List *) PG_GETARG_POINTER(2);
+    int         varRelid = PG_GETARG_INT32(3);
+
+    PG_RETURN_FLOAT8((float8)
+        sexp_operator_selectivity(root, args, varRelid,
+                                  SEXP_GIN_CONTAINS_STRATEGY));
+}
+
+/*
+ * sexp_contains_key_sel - restriction selectivity for @>>
+ */
+Datum
+sexp_contains_key_sel(PG_FUNCTION_ARGS)
+{
+    PlannerInfo *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+    List       *args = (List *) PG_GETARG_POINTER(2);
+    int         varRelid = PG_GETARG_INT32(3);
+
+    PG_RETURN_FLOAT8((float8)
+        sexp_operator_selectivity(root, args, varRelid,
+                                  SEXP_GIN_CONTAINS_KEY_STRATEGY));
+}
+
+/*
+ * sexp_match_sel - restriction selectivity for @~
+ */
+Datum
+sexp_match_sel(PG_FUNCTION_ARGS)
+{
+    PlannerInfo *root = (PlannerInfo *) PG_GETARG_POINTER(0);
+    List       *args = (List *) PG_GETARG_POINTER(2);
+    int         varRelid = PG_GETARG_INT32(3);
+
+    PG_RETURN_FLOAT8((float8)
+        sexp_operator_selectivity(root, args, varRelid,
+                                  SEXP_GIN_MATCHES_STRATEGY));
+}
@@ -0,0 +1,101 @@
+/*
+ * sexp_stats.c
+ *
+ * SQL interface for the per-backend hot-path counters in sexp_stats.h.
+ *
+ * pg_sexp_stats() returns one (name, value) row per counter for the
+ * calling backend; pg_sexp_stats_reset() zeroes them.  See sexp_stats.h
+ * for why the counters are per-backend rather than shared memory.
+ */
+
+#include "pg_sexp.h"
+#include "sexp_stats.h"
+#include "funcapi.h"
+#include "utils/builtins.h"
+
+/* The per-backend counter block, zero-initialized at backend start */
+SexpStatCounters sexp_stat_counters;
+
+PG_FUNCTION_INFO_V1(pg_sexp_stats);
+PG_FUNCTION_INFO_V1(pg_sexp_stats_reset);
+
+/*
+ * Counter catalog - names exposed through pg_sexp_stats().
+ * Keep in sync with SexpStatCounters.
+ */
+typedef struct SexpStatEntry
+{
+    const char *name;
+    const uint64 *value;
+} SexpStatEntry;
+
+static const SexpStatEntry stat_entries[] =
+{
+    {"bloom_rejects", &sexp_stat_counters.bloom_rejects},
+    {"bloom_accepts", &sexp_stat_counters.bloom_accepts},
+    {"gin_values_indexed", &sexp_stat_counters.gin_values_indexed},
+    {"gin_keys_emitted", &sexp_stat_counters.gin_keys_emitted},
+    {"gin_consistent_calls", &sexp_stat_counters.gin_consistent_calls},
+    {"gin_rechecks", &sexp_stat_counters.gin_rechecks},
+    {"parse_calls", &sexp_stat_counters.parse_calls},
+    {"parse_bytes", &sexp_stat_counters.parse_bytes},
+    {"output_calls", &sexp_stat_counters.output_calls},
+    {"output_bytes", &sexp_stat_counters.output_bytes},
+};
+
+#define NUM_STAT_ENTRIES ((int) (sizeof(stat_entries) / sizeof(stat_entries[0])))
+
+/*
+ * pg_sexp_stats - Report this backend's counters as (name, value) rows
+ */
+Datum
+pg_sexp_stats(PG_FUNCTION_ARGS)
+{
+    FuncCallContext *funcctx;
+
+    if (SRF_IS_FIRSTCALL())
+    {
+        MemoryContext oldcontext;
+        TupleDesc   tupdesc;
+
+        funcctx = SRF_FIRSTCALL_INIT();
+        oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+        if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+            elog(ERROR, "return type must be a row type");
+
+        funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+        funcctx->max_calls = NUM_STAT_ENTRIES;
+
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+
+    if (funcctx->call_cntr < funcctx->max_calls)
+    {
+        const SexpStatEntry *entry = &stat_entries[funcctx->call_cntr];
+        Datum       values[2];
+        bool        nulls[2] = {false, false};
+        HeapTuple   tuple;
+
+        values[0] = CStringGetTextDatum(entry->name);
+        values[1] = Int64GetDatum((int64) *entry->value);
+
+        tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+        SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+    }
+
+    SRF_RETURN_DONE(funcctx);
+}
+
+/*
+ * pg_sexp_stats_reset - Zero this backend's counters
+ */
+Datum
+pg_sexp_stats_reset(PG_FUNCTION_ARGS)
+{
+    memset(&sexp_stat_counters, 0, sizeof(sexp_stat_counters));
+
+    PG_RETURN_VOID();
+}
@@ -0,0 +1,52 @@
+/*
+ * sexp_stats.h
+ *
+ * Lightweight runtime counters for pg_sexp hot paths.
+ *
+ * Design philosophy:
+ * ==================
+ * The counters exist to answer tuning questions (is the Bloom filter
+ * rejecting anything? how often does GIN recheck fire? how many keys does
+ * a typical value emit?) without the compile-time sexp_debug.h logging,
+ * which is unusable under load.
+ *
+ * Each counter is a plain per-backend uint64 bumped with an ordinary
+ * increment - no atomics, no locks, no shared memory.  That keeps the
+ * hot-path cost to a single cached add so the counters can stay enabled
+ * in production.  The trade-off is that pg_sexp_stats() reports only the
+ * calling backend; aggregate across backends in SQL if needed.  (True
+ * cluster-wide counters would require shared_preload_libraries for a
+ * shmem request hook, which this extension deliberately avoids.)
+ */
+
+#ifndef SEXP_STATS_H
+#define SEXP_STATS_H
+
+#include "postgres.h"
+
+typedef struct SexpStatCounters
+{
+    /* Bloom filter pre-checks in containment paths (sexp_ops.c) */
+    uint64      bloom_rejects;      /* definite "not contained" answers */
+    uint64      bloom_accepts;      /* passes that fell through to scan */
+
+    /* GIN index support (sexp_gin.c) */
+    uint64      gin_values_indexed; /* calls to sexp_gin_extract_value */
+    uint64      gin_keys_emitted;   /* total keys across indexed values */
+    uint64      gin_consistent_calls;
+    uint64      gin_rechecks;       /* consistent calls requesting recheck */
+
+    /* I/O throughput (pg_sexp.c) */
+    uint64      parse_calls;
+    uint64      parse_bytes;        /* text bytes fed to the parser */
+    uint64      output_calls;
+    uint64      output_bytes;       /* text bytes produced by sexp_out */
+} SexpStatCounters;
+
+extern SexpStatCounters sexp_stat_counters;
+
+/* Hot-path instrumentation - a single increment, always enabled */
+#define SEXP_STAT_INC(field)        (sexp_stat_counters.field++)
+#define SEXP_STAT_ADD(field, n)     (sexp_stat_counters.field += (uint64) (n))
+
+#endif /* SEXP_STATS_H */
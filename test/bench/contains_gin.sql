@@ -0,0 +1,3 @@
+-- pgbench scenario: @> containment through the GIN index
+\set uid random(1, 20000)
+SELECT count(*) FROM bench_docs_gin WHERE expr @> ('(id ' || :uid || ')')::sexp;
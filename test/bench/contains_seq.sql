@@ -0,0 +1,3 @@
+-- pgbench scenario: @> containment, sequential scan (no index)
+\set uid random(1, 20000)
+SELECT count(*) FROM bench_docs WHERE expr @> ('(id ' || :uid || ')')::sexp;
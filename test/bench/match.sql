@@ -0,0 +1,4 @@
+-- pgbench scenario: @~ pattern matching
+\set uid random(1, 20000)
+SELECT count(*) FROM bench_docs
+WHERE expr @~ ('(user (id ' || :uid || ') _*)')::sexp;
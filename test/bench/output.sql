@@ -0,0 +1,3 @@
+-- pgbench scenario: sexp_out serialization
+\set did random(1, 20000)
+SELECT length(expr::text) FROM bench_docs WHERE id = :did;
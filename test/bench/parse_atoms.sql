@@ -0,0 +1,2 @@
+-- pgbench scenario: parse throughput on the atom-heavy corpus
+SELECT length(doc::sexp::text) FROM bench_corpus WHERE kind = 'atoms';
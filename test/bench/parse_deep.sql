@@ -0,0 +1,2 @@
+-- pgbench scenario: parse throughput on the deeply nested corpus
+SELECT length(doc::sexp::text) FROM bench_corpus WHERE kind = 'deep';
@@ -0,0 +1,2 @@
+-- pgbench scenario: parse throughput on the symbol-heavy corpus
+SELECT length(doc::sexp::text) FROM bench_corpus WHERE kind = 'symbols';
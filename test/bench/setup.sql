@@ -0,0 +1,43 @@
+-- Benchmark corpus setup for run_bench.sh
+--
+-- Three parse corpora exercise different hot paths in sexp_parse:
+--   atom-heavy:   long flat lists of numbers (tokenizer + varint encoding)
+--   symbol-heavy: nested structures of repeated symbols (symbol interning)
+--   deep:         heavy nesting (list recursion + SEntry emission)
+-- plus a document table for containment/match/output scenarios, with and
+-- without a GIN index.
+
+DROP TABLE IF EXISTS bench_corpus;
+DROP TABLE IF EXISTS bench_docs;
+DROP TABLE IF EXISTS bench_docs_gin;
+
+-- Raw text corpora, parsed over and over by the parse scenarios
+CREATE TABLE bench_corpus (id serial PRIMARY KEY, kind text NOT NULL, doc text NOT NULL);
+
+INSERT INTO bench_corpus (kind, doc)
+SELECT 'atoms', '(' || string_agg((i * 37 % 100000)::text || ' ' || (i * 0.5)::text, ' ') || ')'
+FROM generate_series(1, 500) i;
+
+INSERT INTO bench_corpus (kind, doc)
+SELECT 'symbols', '(doc ' || string_agg(
+           '(record (user-id ' || i || ') (event "login") (status active) (region us-east))', ' ') || ')'
+FROM generate_series(1, 200) i;
+
+INSERT INTO bench_corpus (kind, doc)
+SELECT 'deep', repeat('(branch (leaf 1) ', 200) || '42' || repeat(')', 200);
+
+-- Parsed documents for containment, pattern match and output scenarios
+CREATE TABLE bench_docs (id serial PRIMARY KEY, expr sexp);
+
+INSERT INTO bench_docs (expr)
+SELECT ('(user (id ' || i || ') (name "user' || i || '") (role ' ||
+        CASE i % 3 WHEN 0 THEN 'admin' WHEN 1 THEN 'editor' ELSE 'viewer' END ||
+        ') (tags (t' || i % 50 || ' t' || i % 7 || ')))')::sexp
+FROM generate_series(1, 20000) i;
+
+-- Same data with a GIN index for the indexed containment scenario
+CREATE TABLE bench_docs_gin AS SELECT * FROM bench_docs;
+CREATE INDEX bench_docs_gin_idx ON bench_docs_gin USING gin (expr sexp_gin_ops);
+
+VACUUM ANALYZE bench_docs;
+VACUUM ANALYZE bench_docs_gin;
@@ -0,0 +1,172 @@
+#!/bin/bash
+#
+# pg_sexp Performance Regression Suite
+#
+# pgbench-driven benchmarks over the documented hot paths: parse throughput
+# (atom-heavy, symbol-heavy, deep-nesting corpora), @> containment with and
+# without GIN, @~ pattern matching, sexp_out serialization, and GIN build
+# time. Results are written as JSON; when a baseline file exists, any
+# scenario slower than the baseline by more than the threshold (default 5%)
+# fails the run, so this can gate CI.
+#
+# Unlike run_benchmark.sh (interactive, container-managed, human-readable
+# reports), this script targets an already-running server and produces
+# machine-readable output:
+#
+#   make bench                     # run against $PGDATABASE, compare baseline
+#   test/run_bench.sh --save-baseline   # record current numbers as baseline
+#
+# Requires: psql, pgbench on PATH; the pg_sexp extension installable in the
+# target database. Standard PG* environment variables select the server.
+
+set -e
+set -o pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BENCH_DIR="$SCRIPT_DIR/bench"
+RESULTS_DIR="$SCRIPT_DIR/results"
+BASELINE_FILE="${BASELINE_FILE:-$RESULTS_DIR/bench_baseline.json}"
+DURATION="${BENCH_DURATION:-10}"
+CLIENTS="${BENCH_CLIENTS:-1}"
+THRESHOLD_PCT="${BENCH_THRESHOLD_PCT:-5}"
+SAVE_BASELINE=false
+TIMESTAMP=$(date +%Y%m%d_%H%M%S)
+OUTPUT_FILE="$RESULTS_DIR/bench_${TIMESTAMP}.json"
+
+usage() {
+    cat <<EOF
+Usage: $(basename "$0") [OPTIONS]
+
+Run the pg_sexp performance regression suite with pgbench.
+
+OPTIONS:
+    -T, --time SECONDS      Duration per scenario (default: 10)
+    -c, --clients N         pgbench client count (default: 1)
+    -b, --baseline FILE     Baseline JSON to compare against
+                            (default: results/bench_baseline.json)
+    -t, --threshold PCT     Regression threshold in percent (default: 5)
+    --save-baseline         Save this run's results as the baseline
+    -h, --help              Show this help message
+
+Scenario throughput is pgbench tps (higher is better); gin_build is
+seconds (lower is better). A scenario regressing by more than the
+threshold against the baseline fails the run with exit code 1.
+EOF
+    exit 0
+}
+
+while [[ $# -gt 0 ]]; do
+    case $1 in
+        -T|--time)       DURATION="$2"; shift 2 ;;
+        -c|--clients)    CLIENTS="$2"; shift 2 ;;
+        -b|--baseline)   BASELINE_FILE="$2"; shift 2 ;;
+        -t|--threshold)  THRESHOLD_PCT="$2"; shift 2 ;;
+        --save-baseline) SAVE_BASELINE=true; shift ;;
+        -h|--help)       usage ;;
+        *) echo "Unknown option: $1" >&2; exit 2 ;;
+    esac
+done
+
+mkdir -p "$RESULTS_DIR"
+
+command -v psql >/dev/null    || { echo "psql not found" >&2; exit 2; }
+command -v pgbench >/dev/null || { echo "pgbench not found" >&2; exit 2; }
+
+echo "Setting up benchmark corpus..."
+psql -qX -v ON_ERROR_STOP=1 -c "CREATE EXTENSION IF NOT EXISTS pg_sexp"
+psql -qX -v ON_ERROR_STOP=1 -f "$BENCH_DIR/setup.sql"
+
+declare -A RESULTS
+
+run_scenario() {
+    local name="$1"
+    local script="$BENCH_DIR/$name.sql"
+    local tps
+
+    echo "Running scenario: $name (${DURATION}s, $CLIENTS client(s))..."
+    tps=$(pgbench -n -T "$DURATION" -c "$CLIENTS" -f "$script" 2>/dev/null |
+          awk '/^tps = /{ print $3; exit }')
+    if [[ -z "$tps" ]]; then
+        echo "  scenario $name produced no tps figure" >&2
+        exit 2
+    fi
+    RESULTS[$name]="$tps"
+    echo "  $name: $tps tps"
+}
+
+run_scenario parse_atoms
+run_scenario parse_symbols
+run_scenario parse_deep
+run_scenario contains_seq
+run_scenario contains_gin
+run_scenario match
+run_scenario output
+
+# GIN build time: seconds to index bench_docs (lower is better)
+echo "Running scenario: gin_build..."
+gin_ms=$(psql -qX -v ON_ERROR_STOP=1 -tA <<'EOF'
+DROP INDEX IF EXISTS bench_docs_build_idx;
+\timing on
+CREATE INDEX bench_docs_build_idx ON bench_docs USING gin (expr sexp_gin_ops);
+\timing off
+DROP INDEX bench_docs_build_idx;
+EOF
+)
+gin_ms=$(echo "$gin_ms" | awk '/^Time: /{ print $2; exit }')
+RESULTS[gin_build]=$(awk -v ms="$gin_ms" 'BEGIN { printf "%.3f", ms / 1000 }')
+echo "  gin_build: ${RESULTS[gin_build]} s"
+
+# Emit JSON (one flat object: scenario -> number)
+{
+    echo "{"
+    first=true
+    for name in parse_atoms parse_symbols parse_deep contains_seq \
+                contains_gin match output gin_build; do
+        $first || echo ","
+        first=false
+        printf '  "%s": %s' "$name" "${RESULTS[$name]}"
+    done
+    echo ""
+    echo "}"
+} > "$OUTPUT_FILE"
+echo "Results written to $OUTPUT_FILE"
+
+if $SAVE_BASELINE; then
+    cp "$OUTPUT_FILE" "$BASELINE_FILE"
+    echo "Baseline saved to $BASELINE_FILE"
+    exit 0
+fi
+
+if [[ ! -f "$BASELINE_FILE" ]]; then
+    echo "No baseline at $BASELINE_FILE - run with --save-baseline to create one."
+    exit 0
+fi
+
+echo "Comparing against baseline $BASELINE_FILE (threshold ${THRESHOLD_PCT}%)..."
+FAILED=0
+for name in parse_atoms parse_symbols parse_deep contains_seq \
+            contains_gin match output gin_build; do
+    base=$(awk -F'[:,]' -v k="\"$name\"" '$1 ~ k { gsub(/[ \t]/, "", $2); print $2 }' \
+           "$BASELINE_FILE")
+    cur="${RESULTS[$name]}"
+    [[ -z "$base" ]] && { echo "  $name: no baseline entry, skipped"; continue; }
+
+    # gin_build is a duration (lower is better); everything else is tps
+    verdict=$(awk -v cur="$cur" -v base="$base" -v thr="$THRESHOLD_PCT" \
+                  -v lower_better="$([[ $name == gin_build ]] && echo 1 || echo 0)" '
+        BEGIN {
+            if (lower_better)
+                delta = (cur - base) / base * 100;      # positive = slower
+            else
+                delta = (base - cur) / base * 100;      # positive = slower
+            printf "%+.1f%% %s", -delta, (delta > thr) ? "FAIL" : "ok";
+        }')
+    echo "  $name: $cur (baseline $base, ${verdict%% *}) ${verdict##* }"
+    [[ "${verdict##* }" == "FAIL" ]] && FAILED=1
+done
+
+if [[ $FAILED -ne 0 ]]; then
+    echo "Performance regression exceeding ${THRESHOLD_PCT}% detected." >&2
+    exit 1
+fi
+echo "All scenarios within ${THRESHOLD_PCT}% of baseline."
@@ -113,6 +113,19 @@ SELECT sexp_match('(+ 1)'::sexp, '(+ _*)'::sexp) AS plus_one_rest;
 SELECT sexp_match('(+)'::sexp, '(+ _*)'::sexp) AS plus_empty_rest;
 SELECT sexp_match('(list a b c d e)'::sexp, '(list _*)'::sexp) AS list_rest;
 
+-- Multi-pattern classification
+\echo 'Multi-pattern tests...'
+SELECT sexp_match_any('(define x 10)'::sexp,
+                      ARRAY['(set! _ _)', '(define _ _)', '(+ _*)']::sexp[]) AS any_hit;
+SELECT sexp_match_any('(lambda (x) x)'::sexp,
+                      ARRAY['(set! _ _)', '(define _ _)']::sexp[]) AS any_miss;
+SELECT sexp_match_which('(define x 10)'::sexp,
+                        ARRAY['(set! _ _)', '(define _ _)', '(define ?n ?v)', '(_ _ _)']::sexp[]) AS which_multi;
+SELECT sexp_match_which('(foo)'::sexp,
+                        ARRAY['(bar _*)', '(baz _*)']::sexp[]) AS which_empty;
+-- Unanchored patterns (no literal head symbol) still run for every document
+SELECT sexp_match_any('42'::sexp, ARRAY['_', '(x _*)']::sexp[]) AS any_atom;
+
 -- Operator syntax
 \echo 'Operator syntax tests...'
 SELECT '(define x 10)'::sexp @~ '(define _ _)'::sexp AS op_match;
@@ -124,6 +137,13 @@ SELECT sexp_find('(+ (* 2 3) (* 4 5))'::sexp, '(* _ _)'::sexp) AS find_mult;
 SELECT sexp_find('(define (square x) (* x x))'::sexp, '(* _ _)'::sexp) AS find_mult_in_define;
 SELECT sexp_find('(a b c)'::sexp, '(x y)'::sexp) AS find_no_match;
 
+-- sexp_find_all tests
+\echo 'Find all pattern tests...'
+SELECT * FROM sexp_find_all('(+ (* 2 3) (* 4 5))'::sexp, '(* _ _)'::sexp);
+SELECT * FROM sexp_find_all('(define (square x) (* x (* x 1)))'::sexp, '(* _ _)'::sexp);
+SELECT * FROM sexp_find_all('(+ (* 2 3) (* 4 5) (* 6 7))'::sexp, '(* _ _)'::sexp, 2);
+SELECT * FROM sexp_find_all('(a b c)'::sexp, '(x y)'::sexp);
+
 -- Practical example: find all function definitions
 \echo 'Practical pattern matching...'
 CREATE TABLE code_sexp (id serial PRIMARY KEY, code sexp);
@@ -199,6 +219,19 @@ SELECT id, expr FROM gin_test WHERE expr @> '(* n n)'::sexp;
 \echo 'Testing no matches...'
 SELECT id, expr FROM gin_test WHERE expr @> '(nonexistent)'::sexp;
 
+\echo 'GIN index: indexed pattern match with wildcards:'
+EXPLAIN (COSTS OFF) SELECT * FROM gin_test WHERE expr @~ '(define (square ?arg) _)'::sexp;
+SELECT id, expr FROM gin_test WHERE expr @~ '(define (square ?arg) _)'::sexp;
+
+\echo 'GIN index: pattern with rest wildcard:'
+SELECT id, expr FROM gin_test WHERE expr @~ '(let _*)'::sexp;
+
+\echo 'GIN index: pattern with no literal keys (falls back to full scan):'
+SELECT id, expr FROM gin_test WHERE expr @~ '(_ _ _)'::sexp ORDER BY id LIMIT 3;
+
+\echo 'GIN index: pattern with no matches:'
+SELECT id, expr FROM gin_test WHERE expr @~ '(nonexistent ?x)'::sexp;
+
 -- Reset
 SET enable_seqscan = on;
 
@@ -219,4 +252,323 @@ SET enable_seqscan = on;
 
 DROP TABLE gin_test;
 
+-- Test path-anchored GIN opclass (sexp_path_ops)
+\echo '=== Testing sexp_path_ops GIN opclass ==='
+CREATE TABLE path_gin_test (id serial PRIMARY KEY, expr sexp);
+INSERT INTO path_gin_test (expr) VALUES
+    ('(config (network (port 8080) (host "db1")))'::sexp),
+    ('(config (network (port 5432) (host "db2")))'::sexp),
+    ('(config (logging (level "debug")))'::sexp),
+    ('(define x 10)'::sexp),
+    ('(define (square n) (* n n))'::sexp),
+    ('(report (network (port 8080)))'::sexp);
+INSERT INTO path_gin_test (expr)
+SELECT ('(item ' || i || ' (data (value ' || (i * 10) || ')))')::sexp
+FROM generate_series(1, 500) AS i;
+
+CREATE INDEX path_gin_test_idx ON path_gin_test USING gin (expr sexp_path_ops);
+ANALYZE path_gin_test;
+SET enable_seqscan = off;
+
+\echo 'Path index: value under nested head chain:'
+EXPLAIN (COSTS OFF) SELECT * FROM path_gin_test WHERE expr @> '(network (port 8080))'::sexp;
+SELECT id, expr FROM path_gin_test WHERE expr @> '(network (port 8080))'::sexp ORDER BY id;
+
+\echo 'Path index: head-only needle:'
+SELECT id, expr FROM path_gin_test WHERE expr @> '(logging (level "debug"))'::sexp;
+
+\echo 'Path index: same value under different head does not match:'
+SELECT count(*) FROM path_gin_test WHERE expr @> '(network (port 9999))'::sexp;
+
+\echo 'Path index: deep chain past the suffix cap still matches:'
+SELECT id FROM path_gin_test WHERE expr @> '(config (network (port 5432) (host "db2")))'::sexp;
+
+\echo 'Path index: bare-atom needle falls back to full scan with recheck:'
+SELECT count(*) FROM path_gin_test WHERE expr @> 'square'::sexp;
+
+SET enable_seqscan = on;
+DROP TABLE path_gin_test;
+
+-- Test element iteration
+\echo 'Testing sexp_elements...'
+SELECT * FROM sexp_elements('(a b c)'::sexp);
+SELECT * FROM sexp_elements('(1 (2 3) "four")'::sexp);
+SELECT * FROM sexp_elements('()'::sexp);
+SELECT * FROM sexp_elements_text('(a 42 "str")'::sexp);
+
+-- Test path extraction
+\echo 'Testing path extraction...'
+SELECT sexp_extract_path('(user (profile (email "a@b.c")))'::sexp, '{profile,email}');
+SELECT '(user (profile (email "a@b.c")))'::sexp #> '{profile,email}';
+SELECT '(user (name "alice") (age 30))'::sexp #> '{age}';
+SELECT '(a b c d)'::sexp #> '{2}';
+SELECT '(item (tags (a b c)))'::sexp #> '{tags,1}';
+SELECT '(user (name "alice"))'::sexp #> '{missing}' IS NULL AS path_miss;
+SELECT '42'::sexp #> '{0}' IS NULL AS atom_miss;
+
+-- Test typed atom accessors (direct binary decode, no text round-trip)
+\echo 'Testing typed accessors...'
+SELECT sexp_as_int('42'::sexp);
+SELECT sexp_as_int('-123456789012'::sexp);
+SELECT sexp_as_float('2.5'::sexp);
+-- Integers promote to float; floats do not truncate to int
+SELECT sexp_as_float('7'::sexp);
+SELECT sexp_as_int('2.5'::sexp) IS NULL AS no_truncation;
+SELECT sexp_as_text('"hello"'::sexp);
+SELECT sexp_as_text('foo'::sexp);
+-- Type mismatches yield NULL rather than erroring
+SELECT sexp_as_int('"nope"'::sexp) IS NULL AS int_mismatch;
+SELECT sexp_as_text('(a b)'::sexp) IS NULL AS text_mismatch;
+-- Path variants reuse the #> descent
+SELECT sexp_as_int('(user (name "alice") (age 30))'::sexp, '{age}');
+SELECT sexp_as_float('(metrics (cpu 0.75))'::sexp, '{cpu}');
+SELECT sexp_as_text('(user (profile (email "a@b.c")))'::sexp, '{profile,email}');
+SELECT sexp_as_int('(a b c 99)'::sexp, '{3}');
+SELECT sexp_as_int('(user (name "alice"))'::sexp, '{missing}') IS NULL AS path_miss;
+
+-- Test ordering operators and btree support
+\echo 'Testing ordering...'
+SELECT '1'::sexp < '2'::sexp;
+SELECT '2'::sexp < '1'::sexp;
+SELECT '10'::sexp < '100'::sexp;
+SELECT '-20'::sexp < '5'::sexp;
+SELECT 'nil'::sexp < '0'::sexp;
+SELECT '42'::sexp < '1.5'::sexp;          -- integers sort before floats
+SELECT 'abc'::sexp < 'abd'::sexp;
+SELECT '"abc"'::sexp < '"abd"'::sexp;
+SELECT 'zzz'::sexp < '"aaa"'::sexp;       -- symbols sort before strings
+SELECT '(a b)'::sexp < '(a c)'::sexp;
+SELECT '(a b)'::sexp < '(a b c)'::sexp;   -- prefix-equal shorter list first
+SELECT sexp_cmp('(a b c)'::sexp, '(a b c)'::sexp);
+SELECT sexp_cmp('(a b)'::sexp, '(a c)'::sexp);
+
+\echo 'Testing ORDER BY and btree index...'
+CREATE TABLE sexp_order_test (id serial PRIMARY KEY, expr sexp);
+INSERT INTO sexp_order_test (expr) VALUES
+    ('(b 2)'::sexp),
+    ('(a 1)'::sexp),
+    ('42'::sexp),
+    ('hello'::sexp),
+    ('"str"'::sexp),
+    ('nil'::sexp);
+
+SELECT expr FROM sexp_order_test ORDER BY expr;
+
+CREATE INDEX sexp_order_btree ON sexp_order_test USING btree (expr);
+SET enable_seqscan = off;
+SELECT expr FROM sexp_order_test WHERE expr < '(a 2)'::sexp AND expr > 'nil'::sexp ORDER BY expr;
+SET enable_seqscan = on;
+
+DROP TABLE sexp_order_test;
+
+-- Test root metadata header (format v7)
+-- Freshly parsed values carry a stored root hash/Bloom; values extracted
+-- by car/nth/captures are emitted without it. Semantics must not differ.
+\echo 'Testing format v7 interop...'
+SELECT '(a b)'::sexp = car('((a b) c)'::sexp) AS eq_across_versions;
+SELECT sexp_hash('(a b)'::sexp) = sexp_hash(car('((a b) c)'::sexp)) AS hash_across_versions;
+SELECT '(a (b c) d)'::sexp @> '(b c)'::sexp;
+SELECT car('((x 1) (y 2))'::sexp) @> 'x'::sexp;
+SELECT cdr('(f (g 1) (g 2))'::sexp)::text;
+
+-- Test append and the expanded in-memory representation
+\echo 'Testing sexp_append...'
+SELECT sexp_append('(a b)'::sexp, 'c'::sexp);
+SELECT sexp_append('()'::sexp, '1'::sexp);
+SELECT sexp_append('(a)'::sexp, '(b c)'::sexp) = '(a (b c))'::sexp;
+-- Appended values must round-trip through flattening with correct
+-- structure and hash, including the large-list format (> 4 elements)
+SELECT sexp_append('(1 2 3 4)'::sexp, '5'::sexp) = '(1 2 3 4 5)'::sexp;
+SELECT sexp_hash(sexp_append('(1 2 3 4)'::sexp, '5'::sexp)) = sexp_hash('(1 2 3 4 5)'::sexp);
+-- Symbols from both arguments share one interned table after remapping
+SELECT sexp_append('(foo bar)'::sexp, '(bar baz)'::sexp)::text;
+-- PL/pgSQL loop: the expanded form is reused across iterations
+DO $$
+DECLARE
+    acc sexp := '()';
+    i int;
+BEGIN
+    FOR i IN 1..100 LOOP
+        acc := sexp_append(acc, i::text::sexp);
+    END LOOP;
+    IF sexp_length(acc) <> 100 THEN
+        RAISE EXCEPTION 'expected 100 elements, got %', sexp_length(acc);
+    END IF;
+    IF nth(acc, 42) <> '43'::sexp THEN
+        RAISE EXCEPTION 'unexpected element at index 42: %', nth(acc, 42);
+    END IF;
+END;
+$$;
+
+-- Test typed constructors
+\echo 'Testing sexp_build_list and typed constructors...'
+SELECT sexp_symbol('foo');
+SELECT sexp_string('hello world');
+SELECT sexp_int(42);
+SELECT sexp_int(-5);
+SELECT sexp_float(3.25);
+-- Constructed values must be identical to parsed ones
+SELECT sexp_build_list(1, 2.5, 'three'::text) = '(1 2.5 "three")'::sexp;
+SELECT sexp_hash(sexp_build_list(1, 2, 3, 4, 5, 6)) = sexp_hash('(1 2 3 4 5 6)'::sexp);
+-- sexp arguments splice in as elements, sharing one symbol table
+SELECT sexp_build_list(sexp_symbol('define'), sexp_build_list(sexp_symbol('x')), 10)::text;
+SELECT sexp_build_list(sexp_symbol('a'), '(a b)'::sexp) = '(a (a b))'::sexp;
+-- NULL becomes nil; empty call builds the empty list
+SELECT sexp_build_list(1, NULL::int, 3)::text;
+SELECT sexp_build_list() = '()'::sexp;
+
+-- Test the list-building aggregate
+\echo 'Testing sexp_agg...'
+SELECT sexp_agg(sexp_int(i)) = '(1 2 3)'::sexp FROM generate_series(1, 3) i;
+-- More than 4 elements exercises the large-list format
+SELECT sexp_agg(sexp_int(i)) = '(1 2 3 4 5 6)'::sexp FROM generate_series(1, 6) i;
+SELECT sexp_hash(sexp_agg(sexp_int(i))) = sexp_hash('(1 2 3 4 5 6)'::sexp)
+FROM generate_series(1, 6) i;
+-- Symbols from all inputs share one merged table
+SELECT sexp_agg(s)::text FROM unnest(ARRAY['(foo 1)', '(bar foo)', 'baz']::sexp[]) s;
+-- NULL inputs become nil, matching sexp_build_list; zero rows yield NULL
+SELECT sexp_agg(s)::text FROM unnest(ARRAY['a', NULL, 'b']::sexp[]) s;
+SELECT sexp_agg(s) IS NULL FROM (SELECT '1'::sexp AS s WHERE false) t;
+-- Aggregated values behave like parsed ones downstream
+SELECT sexp_agg(sexp_int(i)) @> '4'::sexp FROM generate_series(1, 6) i;
+
+-- Test jsonb conversion (binary-to-binary, both directions)
+\echo 'Testing jsonb conversion...'
+SELECT sexp_to_jsonb('(1 2.5 "three" foo ())'::sexp);
+SELECT sexp_to_jsonb('42'::sexp);
+SELECT sexp_to_jsonb('(a (b (c)))'::sexp);
+SELECT jsonb_to_sexp('[1, 2.5, "three", [true, false, null]]'::jsonb)::text;
+SELECT jsonb_to_sexp('{"x": 1, "y": [2, 3]}'::jsonb)::text;
+SELECT jsonb_to_sexp('"scalar"'::jsonb)::text;
+-- Converted values carry correct structure and hashes
+SELECT jsonb_to_sexp('[1, 2, 3, 4, 5, 6]'::jsonb) = '(1 2 3 4 5 6)'::sexp;
+SELECT sexp_hash(jsonb_to_sexp('[1, [2]]'::jsonb)) = sexp_hash('(1 (2))'::sexp);
+
+-- Test deeply nested structures (iterative traversal paths)
+\echo 'Testing deep structure traversal...'
+SELECT s = s AS deep_equal
+FROM (SELECT (repeat('(', 900) || '42' || repeat(')', 900))::sexp AS s) t;
+SELECT s @> '"x"'::sexp AS deep_contains
+FROM (SELECT (repeat('(a ', 500) || '"x"' || repeat(')', 500))::sexp AS s) t;
+SELECT s @>> '"x"'::sexp AS deep_contains_key
+FROM (SELECT (repeat('(a ', 500) || '"x"' || repeat(')', 500))::sexp AS s) t;
+SELECT s @> '(nope)'::sexp AS deep_no_match
+FROM (SELECT (repeat('(a ', 500) || '"x"' || repeat(')', 500))::sexp AS s) t;
+-- Large lists nested inside each other (header insertion at every close)
+SELECT s = s::text::sexp AS nested_large_roundtrip
+FROM (SELECT ('(' || repeat('(x 1 2 3 4 5 6) ', 50) || ')')::sexp AS s) t;
+SELECT nth(nth(('(' || repeat('(y 1 2 3 4 5) ', 10) || ')')::sexp, 9), 5);
+
+-- Test text output (escape scanning and buffer pre-sizing)
+\echo 'Testing text output...'
+SELECT '("a\nb\tc \"quoted\" back\\slash")'::sexp::text;
+SELECT s = s::text::sexp AS large_roundtrip
+FROM (SELECT ('(' || repeat('"clean string content" ', 200) || ')')::sexp AS s) t;
+SELECT s = s::text::sexp AS escaped_roundtrip
+FROM (SELECT ('(' || repeat('"line\none\ttwo\\three" ', 50) || ')')::sexp AS s) t;
+
+-- Test wide Bloom signatures (128/256-bit headers on large documents)
+\echo 'Testing wide Bloom signatures...'
+-- >32 elements stores a 128-bit signature, >96 a 256-bit one
+SELECT s = s::text::sexp AS bloom128_roundtrip
+FROM (SELECT ('(' || repeat('(k 1) ', 40) || ')')::sexp AS s) t;
+SELECT s = s::text::sexp AS bloom256_roundtrip
+FROM (SELECT ('(' || repeat('(k 1) ', 120) || ')')::sexp AS s) t;
+-- Mixed-width containment folds to the narrower signature
+SELECT ('(' || repeat('(item "x") ', 120) || '(needle 42))')::sexp @> '(needle 42)'::sexp AS wide_contains;
+SELECT ('(' || repeat('(item "x") ', 120) || ')')::sexp @> '(absent 1)'::sexp AS wide_rejects;
+-- Constructed and parsed wide documents agree on hashes
+SELECT sexp_hash(('(' || repeat('(k 1) ', 40) || ')')::sexp) =
+       sexp_hash(sexp_append(('(' || repeat('(k 1) ', 39) || ')')::sexp, '(k 1)'::sexp)) AS wide_hash_agree;
+
+-- Test key containment on wide documents (hashed container index)
+\echo 'Testing wide key containment...'
+-- Containers past the cache threshold index their pairs by head-symbol hash
+SELECT ('(cfg ' || string_agg(format('(k%s %s)', i, i), ' ') || ')')::sexp @>>
+       '(cfg (k7 7) (k42 42) (k199 199))'::sexp AS wide_key_hit
+FROM generate_series(1, 200) i;
+SELECT ('(cfg ' || string_agg(format('(k%s %s)', i, i), ' ') || ')')::sexp @>>
+       '(cfg (k7 7) (k42 999) (k199 199))'::sexp AS wide_key_wrong_value
+FROM generate_series(1, 200) i;
+SELECT ('(cfg ' || string_agg(format('(k%s %s)', i, i), ' ') || ')')::sexp @>>
+       '(cfg (missing 1) (k2 2) (k3 3))'::sexp AS wide_key_absent
+FROM generate_series(1, 200) i;
+-- Duplicate keys chain in the index; any matching pair satisfies a probe
+SELECT ('(cfg (dup 1) ' || repeat('(pad 0) ', 20) || '(dup 2))')::sexp @>>
+       '(cfg (dup 2) (pad 0) (dup 1))'::sexp AS wide_dup_keys;
+-- Bare atoms in the needle tail probe by their own hash
+SELECT ('(cfg marker "tag" ' || repeat('(pad 0) ', 20) || ')')::sexp @>>
+       '(cfg "tag" marker (pad 0))'::sexp AS wide_mixed_tail;
+
+-- Test prefix operations on TOASTed values (sliced detoast path)
+\echo 'Testing prefix operations on large values...'
+CREATE TABLE toast_test (id serial PRIMARY KEY, expr sexp);
+ALTER TABLE toast_test ALTER COLUMN expr SET STORAGE external;
+INSERT INTO toast_test (expr)
+    VALUES (('(header-symbol ' || repeat('(entry "payload data here") ', 5000) || ')')::sexp);
+SELECT sexp_typeof(expr) FROM toast_test;
+SELECT car(expr) FROM toast_test;
+SELECT head(expr) FROM toast_test;
+DROP TABLE toast_test;
+
+-- Test shared symbol dictionary
+\echo 'Testing symbol dictionary...'
+SELECT pg_sexp_dict_add('user') > 0;
+SELECT pg_sexp_dict_add('name') > 0;
+SELECT pg_sexp_dict_add('age') > 0;
+-- Re-adding returns the same ID
+SELECT pg_sexp_dict_add('user') = pg_sexp_dict_add('user');
+SET pg_sexp.use_symbol_dictionary = on;
+-- Dictionary-encoded values round-trip and compare equal to inline ones
+SELECT '(user (name "ada") (age 36))'::sexp;
+SELECT '(user (name "ada") (age 36))'::sexp = '(user (name "ada") (age 36))'::sexp;
+-- Dictionary values are smaller than their inline equivalents
+SELECT pg_column_size('(user (name "n") (age 1))'::sexp) <
+       pg_column_size('(inline-only (unknown-sym "n") (other 1))'::sexp) AS dict_smaller;
+-- Unknown symbols fall back to an inline table transparently
+SELECT '(unregistered (name "x"))'::sexp;
+SELECT sexp_hash('(user (name "ada"))'::sexp) AS dict_hash \gset
+SET pg_sexp.use_symbol_dictionary = off;
+-- Inline and dictionary encodings agree on hash, equality and containment
+SELECT sexp_hash('(user (name "ada"))'::sexp) = :dict_hash AS hash_agrees;
+SET pg_sexp.use_symbol_dictionary = on;
+SELECT '(user (name "ada") (age 36))'::sexp @> '(name "ada")'::sexp;
+SELECT '(user (name "ada") (age 36))'::sexp @>> '(age 36)'::sexp;
+SELECT car('(user (name "ada"))'::sexp);
+SELECT nth('(user (name "ada") (age 36))'::sexp, 2);
+SET pg_sexp.use_symbol_dictionary = off;
+
+-- Test zstd dictionary compression
+-- Requires a build with libzstd (the test containers have it).
+\echo 'Testing zstd compression...'
+CREATE TABLE zstd_test (doc sexp);
+INSERT INTO zstd_test
+SELECT format('(event (host "web-%s") (metric (cpu %s) (mem %s)) (tags (env "prod")))',
+              i % 20, i % 100, i * 7 % 4096)::sexp
+FROM generate_series(1, 200) i;
+SELECT sexp_compress_dictionary('zstd_test', 'doc') AS zstd_dict \gset
+SELECT :zstd_dict > 0 AS dict_created;
+-- Round-trip with and without a dictionary
+SELECT sexp_decompress(sexp_compress(doc, :zstd_dict)) = doc AS dict_roundtrip
+FROM zstd_test LIMIT 1;
+SELECT sexp_decompress(sexp_compress(doc, 0)) = doc AS plain_roundtrip
+FROM zstd_test LIMIT 1;
+-- The trained dictionary beats dictionary-less compression on small values
+SELECT octet_length(sexp_compress(doc, :zstd_dict)) <
+       octet_length(sexp_compress(doc, 0)) AS dict_wins
+FROM zstd_test LIMIT 1;
+-- Decompressed values behave like any other sexp
+SELECT sexp_decompress(sexp_compress('(user (name "ada"))'::sexp, :zstd_dict))
+       @> '(name "ada")'::sexp;
+DROP TABLE zstd_test;
+
+-- Test runtime statistics
+\echo 'Testing pg_sexp_stats...'
+SELECT pg_sexp_stats_reset();
+SELECT '(a b c)'::sexp @> 'b'::sexp;
+SELECT count(*) = 10 AS has_all_counters FROM pg_sexp_stats();
+SELECT name FROM pg_sexp_stats() WHERE name = 'parse_calls' AND value > 0;
+SELECT pg_sexp_stats_reset();
+SELECT bool_and(value = 0) AS all_zero_after_reset FROM pg_sexp_stats();
+
 \echo '=== All tests passed! ==='